@@ -1,7 +1,31 @@
-#define MAX_WINS 32
+#define _GNU_SOURCE // memfd_create
+#define MAX_WATCHES 8
+#define MAX_TIMERS 16
+#define MAX_PENS 8
+#define LAT_BUCKETS 24
+#define LOG_SLOTS 256
+#define LOG_LINE 192
+#define MAX_ARGS 32
+#define KEY_ACCEL_MS 700
+#define KEY_MAX_STEP 64
+#define POOL_FRAMES 16
+#define EXTENT_SLOTS 64
+#define FETCH_SLOTS 256
+#define MAX_PINGS 8
+#define PING_MS 3000
+#define TITLE_FONT "monospace:size=9"
+#define FRAME_EVENTS (SubstructureRedirectMask | SubstructureNotifyMask | ExposureMask \
+        | PropertyChangeMask | EnterWindowMask | FocusChangeMask)
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/Xft/Xft.h>
+#include <xcb/xcb.h>
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,19 +33,499 @@
 #include <time.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "layout.h"
 
-// Viewable struct for storing window-frame pair
-// plus possibly some other stuff later
-typedef struct Viewable Viewable;
-struct Viewable {
+// things a key binding can do
+enum { A_RAISE, A_FOCUS, A_MOVE, A_RESIZING, A_SPAWN, A_TILE, A_CLOSE, A_QUIT, A_VIEW, A_SEND,
+    A_TABBED, A_TAB, A_OUTPUT, A_RESTART };
+
+// a key binding, the arg meaning depends on the action (a direction, a tiling mode)
+typedef struct Binding Binding;
+struct Binding {
+    unsigned int mods;
+    KeySym sym;
+    int act;
+    int arg;
+    const char *cmd;
+};
+
+static const Binding bindings[] = {
+    { Mod1Mask,             XK_space, A_RAISE,    0,          NULL },
+    { Mod1Mask,             XK_r,     A_RESIZING, 0,          NULL },
+    { Mod1Mask,             XK_h,     A_FOCUS,    DIR_LEFT,   NULL },
+    { Mod1Mask,             XK_j,     A_FOCUS,    DIR_DOWN,   NULL },
+    { Mod1Mask,             XK_k,     A_FOCUS,    DIR_UP,     NULL },
+    { Mod1Mask,             XK_l,     A_FOCUS,    DIR_RIGHT,  NULL },
+    { Mod1Mask | ShiftMask, XK_h,     A_MOVE,     DIR_LEFT,   NULL },
+    { Mod1Mask | ShiftMask, XK_j,     A_MOVE,     DIR_DOWN,   NULL },
+    { Mod1Mask | ShiftMask, XK_k,     A_MOVE,     DIR_UP,     NULL },
+    { Mod1Mask | ShiftMask, XK_l,     A_MOVE,     DIR_RIGHT,  NULL },
+    { Mod1Mask | ShiftMask, XK_q,     A_CLOSE,    0,          NULL },
+    { Mod1Mask | ShiftMask, XK_e,     A_QUIT,     0,          NULL },
+    { Mod1Mask | ShiftMask, XK_r,     A_RESTART,  0,          NULL },
+    { Mod1Mask,             XK_d,     A_SPAWN,    0,          "dmenu_run" },
+    { Mod1Mask,             XK_b,     A_TILE,     false,      NULL },
+    { Mod1Mask,             XK_v,     A_TILE,     true,       NULL },
+    { Mod1Mask,             XK_t,     A_TABBED,   0,          NULL },
+    { Mod1Mask,             XK_Tab,   A_TAB,      0,          NULL },
+    { Mod1Mask,             XK_comma, A_OUTPUT,   -1,         NULL },
+    { Mod1Mask,             XK_period, A_OUTPUT,  1,         NULL },
+    { Mod1Mask,             XK_1,     A_VIEW,     0,          NULL },
+    { Mod1Mask,             XK_2,     A_VIEW,     1,          NULL },
+    { Mod1Mask,             XK_3,     A_VIEW,     2,          NULL },
+    { Mod1Mask,             XK_4,     A_VIEW,     3,          NULL },
+    { Mod1Mask,             XK_5,     A_VIEW,     4,          NULL },
+    { Mod1Mask,             XK_6,     A_VIEW,     5,          NULL },
+    { Mod1Mask,             XK_7,     A_VIEW,     6,          NULL },
+    { Mod1Mask,             XK_8,     A_VIEW,     7,          NULL },
+    { Mod1Mask,             XK_9,     A_VIEW,     8,          NULL },
+    { Mod1Mask | ShiftMask, XK_1,     A_SEND,     0,          NULL },
+    { Mod1Mask | ShiftMask, XK_2,     A_SEND,     1,          NULL },
+    { Mod1Mask | ShiftMask, XK_3,     A_SEND,     2,          NULL },
+    { Mod1Mask | ShiftMask, XK_4,     A_SEND,     3,          NULL },
+    { Mod1Mask | ShiftMask, XK_5,     A_SEND,     4,          NULL },
+    { Mod1Mask | ShiftMask, XK_6,     A_SEND,     5,          NULL },
+    { Mod1Mask | ShiftMask, XK_7,     A_SEND,     6,          NULL },
+    { Mod1Mask | ShiftMask, XK_8,     A_SEND,     7,          NULL },
+    { Mod1Mask | ShiftMask, XK_9,     A_SEND,     8,          NULL },
+};
+
+#define NBINDINGS ((int)(sizeof(bindings) / sizeof(bindings[0])))
+#define MOD_MASKS (ShiftMask | ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)
+
+// bindings looked up directly by keycode and modifiers (with the lock modifiers
+// cleaned out), -1 where nothing is bound. rebuilt whenever the keyboard mapping changes
+typedef struct Keys Keys;
+struct Keys {
+    signed char map[256][256];
+    unsigned int numlock;
+};
+
+// a graphics context with its colors (and font, if any) already set,
+// created on first use and then shared by every frame that asks for the same combination
+typedef struct Pen Pen;
+struct Pen {
+    unsigned long bg;
+    unsigned long fg;
+    Font fid;
+    GC gc;
+};
+
+// one measured title, see title_width
+typedef struct Extent Extent;
+struct Extent {
+    unsigned long hash;
+    char *str;
+    int wid;
+};
+
+// everything needed to fetch and draw titles. xft keeps the glyphs it has already
+// uploaded in a server-side glyph set per font, so the font is opened once and never
+// closed, and measured strings are remembered since titles tend to flip back and forth
+// (eg browser tabs)
+typedef struct Titles Titles;
+struct Titles {
+    XftFont *font;
+    XftColor fg;
+    Visual *visual;
+    Colormap cmap;
+    Atom netName;
+    Atom utf8;
+    Extent extents[EXTENT_SLOTS];
+};
+
+// frames that are created ahead of time (and handed back when their client goes away),
+// so mapping a window only has to reparent and configure
+typedef struct FramePool FramePool;
+struct FramePool {
+    Window frms[POOL_FRAMES];
+    int n;
+};
+
+// an extra file descriptor for the main loop to wake up on, besides the X connection
+typedef struct Watch Watch;
+struct Watch {
+    int fd;
+    void (*cb)(int fd, void *data);
+    void *data;
+};
+
+// one-shot timer, fired from the main loop once its deadline (monotonic ms) has passed
+typedef struct Timer Timer;
+struct Timer {
+    unsigned long long when;
+    void (*cb)(void *data);
+    void *data;
+};
+
+// everything the main loop can block on
+typedef struct Loop Loop;
+struct Loop {
+    Watch wtch[MAX_WATCHES];
+    int nwtch;
+    Timer tmrs[MAX_TIMERS];
+};
+
+// log levels, anything above LOG_LEVEL is compiled out entirely (build with
+// -DLOG_LEVEL=LOG_DEBUG to get it back), ARMW_LOG picks a lower level at runtime
+enum { LOG_ERR, LOG_WARN, LOG_INFO, LOG_DEBUG };
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_WARN
+#endif
+
+// lines are formatted into a preallocated ring by the event loop and written out by
+// a separate thread, so a slow stdout can never hold up event handling
+typedef struct LogRing LogRing;
+struct LogRing {
+    char lines[LOG_SLOTS][LOG_LINE];
+    atomic_uint head;      // next slot the event loop writes
+    atomic_uint tail;      // next slot the writer thread prints
+    atomic_ulong dropped;  // lines lost because the ring was full
+    unsigned int kicked;   // head the last time the writer was woken
+    int level;
+    int efd;               // wakes the writer thread, -1 means drain inline
+    pthread_mutex_t drain; // only one drainer at a time (the thread, or log_flush)
+};
+
+static LogRing logs = { .level = LOG_LEVEL, .efd = -1, .drain = PTHREAD_MUTEX_INITIALIZER };
+
+#define LOG(lvl, ...) do { \
+    if ((lvl) <= LOG_LEVEL && (lvl) <= logs.level) { log_push(__VA_ARGS__); } \
+} while (0)
+
+// kinds of requests that block until the server answers
+// (client properties are read by the fetch worker instead, see Fetcher)
+enum { RT_GEOM, RT_SYNC, RT_RANDR, RT_MODMAP, RT_KINDS };
+const char *rtNames[RT_KINDS] = {
+    "XGetGeometry", "XSync", "XRRGet*", "XGetModifierMapping"
+};
+
+// what handling each event type costs: how often, how long (log2 histogram of
+// microseconds), how many requests in total and how many of those were round trips
+typedef struct EventStats EventStats;
+struct EventStats {
+    unsigned long count;
+    unsigned long lat[LAT_BUCKETS];
+    unsigned long long maxus;
+    unsigned long reqs;
+    unsigned long rts[RT_KINDS];
+};
+
+typedef struct Stats Stats;
+struct Stats {
+    EventStats evts[LASTEvent];
+    int cur;                // event type being handled right now, -1 between events
+    unsigned long long t0;  // when handling it started
+    unsigned long req0;     // and the request serial at that point
+    // where SIGUSR1 publishes the dump
+    Display *dsp;
+    Window root;
+    Atom prop;
+};
+
+// there is just the one, so anything that talks to the server can count its round trips
+static Stats stats = { .cur = -1 };
+
+// client properties the fetch worker reads for the event loop
+enum { F_TITLE, F_HINTS, F_PROTOCOLS, F_KINDS };
+
+// what a client's WM_PROTOCOLS says it takes, plus our own bookkeeping:
+// known once it has been read, close while a close waits for that
+enum { P_DELETE = 1, P_PING = 2, P_KNOWN = 4, P_CLOSE = 8 };
+
+// one read, the answer gets filled in by the worker
+typedef struct Fetch Fetch;
+struct Fetch {
+    int kind;
     Window wndw;
-    Window fram;
-    int left;
-    int rite;
-    int topp;
-    int botm;
+    char *ttl;        // F_TITLE, handed over to the Viewable
+    XSizeHints hints; // F_HINTS
+    bool ok;          // F_HINTS: there are any
+    int prot;         // F_PROTOCOLS: P_* bits
+};
+
+// single producer, single consumer, there's one going each way
+typedef struct FetchRing FetchRing;
+struct FetchRing {
+    Fetch jobs[FETCH_SLOTS];
+    atomic_uint head;
+    atomic_uint tail;
+};
+
+// the worker thread, with a connection of its own so that a slow property read
+// never holds up the event loop's. dsp is NULL if it couldn't be started
+typedef struct Fetcher Fetcher;
+struct Fetcher {
+    Display *dsp;
+    Titles *ttls;         // only the atoms are used
+    Atom delete;
+    Atom ping;
+    FetchRing todo;
+    FetchRing done;
+    unsigned int kicked;  // todo.head the last time the worker was woken
+    bool behind;          // some reads didn't fit, see fetch_retry
+    int wake;             // eventfd the worker sleeps on
+    int back;             // eventfd the event loop watches for answers
+    atomic_ulong sent;    // requests the worker has made, only kept up with ARMW_BENCH
+};
+
+static Fetcher fetcher = { .wake = -1, .back = -1 };
+
+// a close in progress: the client got WM_DELETE_WINDOW and _NET_WM_PING,
+// and gets killed if it hasn't answered the ping by the time the timer fires
+typedef struct Ping Ping;
+typedef struct Pings Pings;
+struct Ping {
+    Pings *all;
+    Window wndw; // None for a free slot
+    int tmr;     // -1 for a free slot, the id may already be some other timer's
+};
+
+struct Pings {
+    Display *dsp;
+    Loop *loop;
+    Atom protocols;
+    Atom delete;
+    Atom ping;
+    Ping slots[MAX_PINGS];
+};
+
+// a mouse drag in progress, moving (button 1) or resizing (button 3) one client
+typedef struct Drag Drag;
+struct Drag {
+    Display *dsp;
+    Backend *be;
+    Table *wins;
+    Loop *loop;
+    Outputs *outs;           // for the refresh rate
+    Window wndw;             // None while nothing is dragged
+    unsigned int button;
+    int x0, y0;              // where the pointer went down
+    Geom fg0, wg0;           // and the geometry at that point
+    int x, y;                // where it is now
+    bool dirty;              // moved since the last configure
+    unsigned long long last; // when that configure went out
+    int tmr;                 // the timer sending the next one, -1 if there's none
+};
+
+// wrap a round trip call with this so it gets charged to the event being handled
+#define RT(kind, call) (stats.evts[stats.cur == -1 ? 0 : stats.cur].rts[kind]++, (call))
+
+const char *eventNames[LASTEvent] = {
+    "Startup", "", "KeyPress", "KeyRelease", "ButtonPress", "ButtonRelease", "MotionNotify",
+    "EnterNotify", "LeaveNotify", "FocusIn", "FocusOut", "KeymapNotify", "Expose",
+    "GraphicsExpose", "NoExpose", "VisibilityNotify", "CreateNotify", "DestroyNotify",
+    "UnmapNotify", "MapNotify", "MapRequest", "ReparentNotify", "ConfigureNotify",
+    "ConfigureRequest", "GravityNotify", "ResizeRequest", "CirculateNotify",
+    "CirculateRequest", "PropertyNotify", "SelectionClear", "SelectionRequest",
+    "SelectionNotify", "ColormapNotify", "ClientMessage", "MappingNotify", "GenericEvent"
 };
 
+// milliseconds from a clock that never jumps, used for timers
+unsigned long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// formats one line into the ring, or drops it if the writer has fallen too far behind
+void log_push(const char *fmt, ...) {
+    unsigned int head = atomic_load_explicit(&logs.head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&logs.tail, memory_order_acquire) >= LOG_SLOTS) {
+        atomic_fetch_add(&logs.dropped, 1);
+        return;
+    }
+    char *line = logs.lines[head % LOG_SLOTS];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, LOG_LINE, fmt, args);
+    va_end(args);
+    if (len < 0) {
+        line[0] = '\0';
+    }
+    atomic_store_explicit(&logs.head, head + 1, memory_order_release);
+}
+
+// writes out everything currently in the ring
+void log_drain() {
+    pthread_mutex_lock(&logs.drain);
+    unsigned int tail = atomic_load_explicit(&logs.tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&logs.head, memory_order_acquire);
+    for (; tail != head; tail++) {
+        char *line = logs.lines[tail % LOG_SLOTS];
+        size_t len = strnlen(line, LOG_LINE);
+        if (write(STDOUT_FILENO, line, len) < 0 || write(STDOUT_FILENO, "\n", 1) < 0) {
+            // nowhere to complain to, just keep the ring moving
+        }
+        atomic_store_explicit(&logs.tail, tail + 1, memory_order_release);
+    }
+    unsigned long dropped = atomic_exchange(&logs.dropped, 0);
+    if (dropped > 0) {
+        char note[64];
+        int len = snprintf(note, sizeof(note), "(%lu log lines dropped)\n", dropped);
+        if (write(STDOUT_FILENO, note, len) < 0) {
+        }
+    }
+    pthread_mutex_unlock(&logs.drain);
+}
+
+void *log_writer(void *arg) {
+    uint64_t n;
+    while (read(logs.efd, &n, sizeof(n)) == sizeof(n) || errno == EINTR) {
+        log_drain();
+    }
+    return NULL;
+}
+
+// picks the runtime level from ARMW_LOG and starts the writer thread
+void log_init() {
+    char *lvl = getenv("ARMW_LOG");
+    if (lvl != NULL) {
+        if (strcmp(lvl, "error") == 0) { logs.level = LOG_ERR; }
+        else if (strcmp(lvl, "warn") == 0) { logs.level = LOG_WARN; }
+        else if (strcmp(lvl, "info") == 0) { logs.level = LOG_INFO; }
+        else if (strcmp(lvl, "debug") == 0) { logs.level = LOG_DEBUG; }
+    }
+
+    logs.efd = eventfd(0, EFD_CLOEXEC);
+    pthread_t thr;
+    if (logs.efd != -1 && pthread_create(&thr, NULL, log_writer, NULL) != 0) {
+        close(logs.efd);
+        logs.efd = -1;
+    }
+}
+
+// called when the event queue runs dry, hands whatever was logged to the writer
+void log_kick() {
+    unsigned int head = atomic_load_explicit(&logs.head, memory_order_relaxed);
+    if (head == logs.kicked) {
+        return;
+    }
+    logs.kicked = head;
+    if (logs.efd == -1) {
+        log_drain();
+    } else {
+        uint64_t one = 1;
+        if (write(logs.efd, &one, sizeof(one)) < 0) {
+            log_drain();
+        }
+    }
+}
+
+// same clock in microseconds, for measuring how long handlers take
+unsigned long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// register an fd so that the main loop calls cb whenever it becomes readable
+bool add_watch(Loop *loop, int fd, void (*cb)(int, void *), void *data) {
+    if (loop->nwtch == MAX_WATCHES) {
+        return false;
+    }
+    loop->wtch[loop->nwtch].fd = fd;
+    loop->wtch[loop->nwtch].cb = cb;
+    loop->wtch[loop->nwtch].data = data;
+    loop->nwtch++;
+    return true;
+}
+
+void remove_watch(Loop *loop, int fd) {
+    for (int i = 0; i < loop->nwtch; i++) {
+        if (loop->wtch[i].fd == fd) {
+            loop->wtch[i] = loop->wtch[--loop->nwtch];
+            return;
+        }
+    }
+}
+
+// schedule cb to run in ms milliseconds, returns an id for cancel_timer or -1 if full
+int add_timer(Loop *loop, unsigned long long ms, void (*cb)(void *), void *data) {
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        if (loop->tmrs[i].cb == NULL) {
+            loop->tmrs[i].when = now_ms() + ms;
+            loop->tmrs[i].cb = cb;
+            loop->tmrs[i].data = data;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void cancel_timer(Loop *loop, int id) {
+    if (id >= 0 && id < MAX_TIMERS) {
+        loop->tmrs[id].cb = NULL;
+    }
+}
+
+// sleeps until the X connection, a watched fd or the nearest timer needs attention,
+// then runs whatever timers and watches are due. X events are left for XPending/XNextEvent
+void wait_for_events(Loop *loop, Display *dsp) {
+    struct pollfd fds[MAX_WATCHES + 1];
+    int nfds = 0;
+    fds[nfds].fd = ConnectionNumber(dsp);
+    fds[nfds].events = POLLIN;
+    nfds++;
+    for (int i = 0; i < loop->nwtch; i++) {
+        fds[nfds].fd = loop->wtch[i].fd;
+        fds[nfds].events = POLLIN;
+        nfds++;
+    }
+
+    // block forever unless a timer is pending
+    int timeout = -1;
+    unsigned long long now = now_ms();
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        if (loop->tmrs[i].cb != NULL) {
+            int left = loop->tmrs[i].when > now ? loop->tmrs[i].when - now : 0;
+            if (timeout == -1 || left < timeout) {
+                timeout = left;
+            }
+        }
+    }
+
+    if (poll(fds, nfds, timeout) < 0 && errno != EINTR) {
+        LOG(LOG_ERR, "poll: %s", strerror(errno));
+        return;
+    }
+
+    now = now_ms();
+    for (int i = 0; i < MAX_TIMERS; i++) {
+        if (loop->tmrs[i].cb != NULL && loop->tmrs[i].when <= now) {
+            // clear the slot first so the callback can re-arm itself
+            void (*cb)(void *) = loop->tmrs[i].cb;
+            loop->tmrs[i].cb = NULL;
+            cb(loop->tmrs[i].data);
+        }
+    }
+
+    // watches may add or remove other watches, so look each fd up again before calling
+    for (int i = 1; i < nfds; i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        for (int j = 0; j < loop->nwtch; j++) {
+            if (loop->wtch[j].fd == fds[i].fd) {
+                loop->wtch[j].cb(fds[i].fd, loop->wtch[j].data);
+                break;
+            }
+        }
+    }
+}
+
 // used for window positioning
 int gen_suitable_random(int max, int limiter) {
     return rand() % (max - limiter);
@@ -29,92 +533,1110 @@ int gen_suitable_random(int max, int limiter) {
 
 // simple error handler called when something goes wrong
 int handle_error(Display *dsp, XErrorEvent *err) {
+    if (dsp == fetcher.dsp) {
+        return 0; // the worker reads windows that may be gone already, and it can't log
+    }
     char err_text[1024];
     XGetErrorText(dsp, err->error_code, err_text, sizeof(err_text));
-    puts("Encountered Error!");
-    printf("Request:     %d\nError code:  %d\nError text:  %s\nResource ID: %d\n",
+    LOG(LOG_WARN, "Encountered Error! Request: %d Error code: %d Error text: %s Resource ID: %lu",
             err->request_code, err->error_code, err_text, err->resourceid);
     return 0;
 }
 
+// called right after XNextEvent, starts charging time and requests to this event type
+void stats_begin(Display *dsp, int type) {
+    stats.cur = type >= 0 && type < LASTEvent ? type : 0;
+    stats.t0 = now_us();
+    stats.req0 = NextRequest(dsp);
+}
+
+// closes off the event started by stats_begin, if there is one
+void stats_end(Display *dsp) {
+    if (stats.cur == -1) {
+        return;
+    }
+    EventStats *es = &stats.evts[stats.cur];
+    unsigned long long us = now_us() - stats.t0;
+    int b = 0;
+    while (b < LAT_BUCKETS - 1 && (1ull << b) <= us) { b++; }
+    es->lat[b]++;
+    es->count++;
+    es->reqs += NextRequest(dsp) - stats.req0;
+    if (us > es->maxus) { es->maxus = us; }
+    stats.cur = -1;
+}
+
+// upper bound (in us) of the histogram bucket holding the given fraction of samples
+unsigned long long stats_percentile(EventStats *es, double frac) {
+    unsigned long want = es->count * frac;
+    unsigned long seen = 0;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += es->lat[b];
+        if (seen > want) { return 1ull << b; }
+    }
+    return es->maxus;
+}
+
+// formats every event type that was seen at least once, returns the length written
+int stats_format(char *buf, int size) {
+    int len = snprintf(buf, size, "%-16s %8s %8s %8s %8s %9s  round trips\n",
+            "event", "count", "p50<us", "p99<us", "max us", "reqs/evt");
+    for (int t = 0; t < LASTEvent && len < size; t++) {
+        EventStats *es = &stats.evts[t];
+        if (es->count == 0) {
+            continue;
+        }
+        len += snprintf(buf + len, size - len, "%-16s %8lu %8llu %8llu %8llu %9.2f ",
+                eventNames[t], es->count, stats_percentile(es, 0.5), stats_percentile(es, 0.99),
+                es->maxus, (double)es->reqs / es->count);
+        for (int k = 0; k < RT_KINDS && len < size; k++) {
+            if (es->rts[k] > 0) {
+                len += snprintf(buf + len, size - len, " %s=%.2f", rtNames[k],
+                        (double)es->rts[k] / es->count);
+            }
+        }
+        if (len < size) {
+            len += snprintf(buf + len, size - len, "\n");
+        }
+    }
+    return len < size ? len : size - 1;
+}
+
+// dumps the stats to stderr and the _ARMW_STATS root property, done on SIGUSR1
+void stats_dump() {
+    char buf[8192];
+    int len = stats_format(buf, sizeof(buf));
+    fputs(buf, stderr);
+    XChangeProperty(stats.dsp, stats.root, stats.prop, XA_STRING, 8, PropModeReplace,
+            (unsigned char *)buf, len);
+    XFlush(stats.dsp);
+}
+
+// SIGUSR1 and SIGCHLD are blocked and read through a signalfd watched by the main loop
+void handle_signals(int fd, void *data) {
+    struct signalfd_siginfo si;
+    bool reap = false;
+    bool dump = false;
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo == SIGCHLD) { reap = true; }
+        if (si.ssi_signo == SIGUSR1) { dump = true; }
+    }
+    // several exits can share one SIGCHLD, so collect everything that is ready
+    if (reap) {
+        pid_t pid;
+        int status;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            LOG(LOG_DEBUG, "Reaped child %d", pid);
+        }
+    }
+    if (dump) {
+        stats_dump();
+    }
+}
+
 // used to run external commands (eg dmenu) without stopping the wm
+// the command is split on whitespace and spawned directly, without a shell in between,
+// and the child gets reaped by handle_signals once it exits
 void start_external(char *toRun) {
-    if (fork() == 0) {
-        puts("This is the child speaking");
-        system(toRun);
-        exit(0);
+    char buf[256];
+    char *argv[MAX_ARGS];
+    int argc = 0;
+    snprintf(buf, sizeof(buf), "%s", toRun);
+    for (char *tok = strtok(buf, " \t"); tok != NULL && argc < MAX_ARGS - 1; tok = strtok(NULL, " \t")) {
+        argv[argc++] = tok;
+    }
+    argv[argc] = NULL;
+    if (argc == 0) {
+        return;
+    }
+
+    // we block the signals that we read through signalfd, the child shouldn't inherit that
+    posix_spawnattr_t attr;
+    sigset_t none, dflt;
+    sigemptyset(&none);
+    sigemptyset(&dflt);
+    sigaddset(&dflt, SIGCHLD);
+    sigaddset(&dflt, SIGUSR1);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &dflt);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    extern char **environ;
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        LOG(LOG_WARN, "Could not start %s: %s", toRun, strerror(err));
     } else {
-        puts("This is the parent speaking");
+        LOG(LOG_DEBUG, "Started %s as %d", toRun, pid);
     }
 }
 
-// called in main loop, draws title string to the bottom left of a frame
-void draw_title_on_frame(Display *dsp, Window frame, XFontStruct *font,
-        char *title, int ascent, int descent) {
-    XWindowAttributes frAttrs;
-    XGetWindowAttributes(dsp, frame, &frAttrs);
-    GC gc = XCreateGC(dsp, frame, 0, 0);
+// the core's requests, done with Xlib. the ctx is the Display
+unsigned long x_configure(void *ctx, Xid w, Geom g) {
+    Display *dsp = ctx;
+    unsigned long ser = NextRequest(dsp);
+    XMoveResizeWindow(dsp, w, g.x, g.y, g.w, g.h);
+    return ser;
+}
 
-    XSetBackground(dsp, gc, 0x181818);
-    XSetForeground(dsp, gc, 0x7cafc2);
-    XSetFont(dsp, gc, font->fid);
+void x_map(void *ctx, Xid w) {
+    XMapWindow(ctx, w);
+}
 
-    XClearArea(dsp, frame, 0, frAttrs.height - ascent - descent, frAttrs.width, ascent + descent, true);
-    XDrawString(dsp, frame, gc, 2, frAttrs.height - descent, title, strlen(title));
+void x_unmap(void *ctx, Xid w) {
+    XUnmapWindow(ctx, w);
 }
 
-// todo: delet this
-int find_window_in_array(Window *winarray, Window query) {
-    for (int i = 0; i < MAX_WINS; i++) {
-        if (query == winarray[i]) {
-            return i;
+void x_focus(void *ctx, Xid w) {
+    Display *dsp = ctx;
+    XSetInputFocus(dsp, w != 0 ? w : DefaultRootWindow(dsp), RevertToPointerRoot, CurrentTime);
+}
+
+// refetches the output areas. with randr that's one rectangle per lit crtc (mirrors
+// only count once), otherwise, or if randr has nothing to say, it's the whole root
+void query_outputs(Display *dsp, Window root, Outputs *outs) {
+    outs->n = 0;
+    outs->hz = 0;
+#ifdef XRANDR
+    XRRScreenResources *res = outs->evb != -1
+        ? RT(RT_RANDR, XRRGetScreenResourcesCurrent(dsp, root)) : NULL;
+    for (int c = 0; res != NULL && c < res->ncrtc && outs->n < MAX_OUTPUTS; c++) {
+        XRRCrtcInfo *crtc = RT(RT_RANDR, XRRGetCrtcInfo(dsp, res, res->crtcs[c]));
+        if (crtc == NULL) {
+            continue;
+        }
+        Geom area = { crtc->x, crtc->y, crtc->width, crtc->height };
+        bool dup = crtc->mode == None || area.w == 0;
+        for (int m = 0; m < outs->n && !dup; m++) {
+            dup = memcmp(&area, &outs->area[m], sizeof(Geom)) == 0;
+        }
+        if (!dup) {
+            outs->area[outs->n++] = area;
+        }
+        // the refresh rate comes with the mode, and the mode list is already here
+        for (int m = 0; m < res->nmode; m++) {
+            XRRModeInfo *mode = &res->modes[m];
+            if (mode->id == crtc->mode && mode->hTotal != 0 && mode->vTotal != 0) {
+                int hz = (double)mode->dotClock / ((double)mode->hTotal * mode->vTotal) + 0.5;
+                if (hz > outs->hz) { outs->hz = hz; }
+            }
         }
+        XRRFreeCrtcInfo(crtc);
     }
-    return -1;
+    if (res != NULL) {
+        XRRFreeScreenResources(res);
+    }
+#endif
+    if (outs->n == 0) {
+        Window rt;
+        int x, y;
+        unsigned int w, h, bw, depth;
+        RT(RT_GEOM, XGetGeometry(dsp, root, &rt, &x, &y, &w, &h, &bw, &depth));
+        Geom area = { 0, 0, w, h };
+        outs->area[outs->n++] = area;
+    }
+    if (outs->hz == 0) {
+        outs->hz = 60; // a good guess when randr can't tell
+    }
+    for (int m = 0; m < outs->n; m++) {
+        Geom *a = &outs->area[m];
+        LOG(LOG_INFO, "Output %d: %dx%d @ %d,%d", m, a->w, a->h, a->x, a->y);
+    }
+}
+
+// the screen changed: refetch the outputs, move the windows of outputs that went away
+// over to the first one, and relayout only the visible trees whose area changed.
+// hidden workspaces catch up once they are shown. the caller flushes once.
+// the trees keep their old areas until then, that's how the change gets noticed
+void outputs_changed(Display *dsp, Backend *be, Window root, Outputs *outs,
+        Workspace *spaces, int cur, Table *wins, int titleh) {
+    query_outputs(dsp, root, outs);
+    for (int i = 0; i < wins->used; i++) {
+        Viewable *vwbl = &wins->vwbls[i];
+        if (vwbl->wndw == 0 || vwbl->outp < outs->n) {
+            continue;
+        }
+        Workspace *wksp = &spaces[vwbl->wksp];
+        tree_detach(be, tree_of(spaces, vwbl), wins, i, titleh);
+        Tree *dest = &wksp->trees[0];
+        int dirty = tree_insert(dest, wins, dest->root, i, false);
+        vwbl->outp = 0;
+        // a tree that's about to be laid out whole can skip the partial layout
+        if (memcmp(&dest->area, &outs->area[0], sizeof(Geom)) == 0) {
+            tree_layout(be, dest, wins, dirty, dest->nodes[dirty].area, titleh);
+        }
+        tree_show(be, dest, wins, dirty, tree_visible(dest, dirty));
+    }
+    for (int n = 0; n < NSPACES; n++) {
+        if (spaces[n].outp >= outs->n) {
+            spaces[n].outp = 0;
+        }
+    }
+    layout_outputs(be, &spaces[cur], wins, outs, titleh);
+}
+
+// looks up (or creates, if there's room) the pen for a color/font combination
+// GCs are never freed, there are only ever a handful of them
+GC get_pen(Display *dsp, Window root, Pen *pens,
+        unsigned long bg, unsigned long fg, Font fid) {
+    for (int i = 0; i < MAX_PENS; i++) {
+        if (pens[i].gc != NULL && pens[i].bg == bg && pens[i].fg == fg && pens[i].fid == fid) {
+            return pens[i].gc;
+        }
+    }
+    for (int i = 0; i < MAX_PENS; i++) {
+        if (pens[i].gc == NULL) {
+            XGCValues vals;
+            vals.background = bg;
+            vals.foreground = fg;
+            vals.font = fid;
+            vals.graphics_exposures = false; // copying titles around shouldn't send NoExpose
+            pens[i].bg = bg;
+            pens[i].fg = fg;
+            pens[i].fid = fid;
+            unsigned long mask = GCBackground | GCForeground | GCGraphicsExposures;
+            if (fid != None) { mask |= GCFont; }
+            pens[i].gc = XCreateGC(dsp, root, mask, &vals);
+            return pens[i].gc;
+        }
+    }
+    // out of slots, reuse the first pen rather than leaking a new GC per frame
+    return pens[0].gc;
+}
+
+// creates a frame the way every frame looks, unmapped and already listening for events
+Window create_frame(Display *dsp, Window root) {
+    Window frame = XCreateSimpleWindow(dsp, root, 0, 0, 1, 1, 2, 0x7cafc2, 0x181818);
+    XSelectInput(dsp, frame, FRAME_EVENTS);
+    return frame;
+}
+
+// tops the pool back up, done while the wm is idle so that maps don't pay for it
+void pool_fill(Display *dsp, Window root, FramePool *pool) {
+    if (pool->n == POOL_FRAMES) {
+        return;
+    }
+    while (pool->n < POOL_FRAMES) {
+        pool->frms[pool->n++] = create_frame(dsp, root);
+    }
+    XFlush(dsp);
+}
+
+// a ready frame, straight from the pool unless it ran dry
+Window pool_take(Display *dsp, Window root, FramePool *pool) {
+    if (pool->n > 0) {
+        return pool->frms[--pool->n];
+    }
+    return create_frame(dsp, root);
+}
+
+// hands every client back to the root, mapped and where it was on screen, and takes its
+// frame down. frames picked up after a restart belong to the old (retained) connection,
+// so the server's save-set processing wouldn't do this for them once we're gone. whatever
+// that connection left behind goes with it
+void release_clients(Display *dsp, Window root, Table *wins) {
+    for (int i = 0; i < wins->used; i++) {
+        Viewable *vwbl = &wins->vwbls[i];
+        if (vwbl->wndw == 0 || vwbl->fram == 0) {
+            continue;
+        }
+        XReparentWindow(dsp, vwbl->wndw, root, vwbl->fgeo.x + vwbl->wgeo.x,
+                vwbl->fgeo.y + vwbl->wgeo.y);
+        XMapWindow(dsp, vwbl->wndw);
+        XDestroyWindow(dsp, vwbl->fram);
+    }
+    XKillClient(dsp, AllTemporary);
+    RT(RT_SYNC, XSync(dsp, false));
+}
+
+// an unmapped frame that is done with its client, kept for the next map if there's room
+void pool_give(Display *dsp, FramePool *pool, Window frame) {
+    if (pool->n < POOL_FRAMES) {
+        pool->frms[pool->n++] = frame;
+    } else {
+        XDestroyWindow(dsp, frame);
+    }
+}
+
+// drops the title pixmap (and xft's draw on it)
+void free_title(Display *dsp, Viewable *vwbl) {
+    if (vwbl->txft != NULL) {
+        XftDrawDestroy(vwbl->txft);
+        vwbl->txft = NULL;
+    }
+    if (vwbl->tpix != None) {
+        XFreePixmap(dsp, vwbl->tpix);
+        vwbl->tpix = None;
+    }
+}
+
+// djb2, only used to pick an extents slot
+unsigned long hash_string(const char *str) {
+    unsigned long h = 5381;
+    for (; *str != '\0'; str++) {
+        h = h * 33 + (unsigned char)*str;
+    }
+    return h;
 }
 
-// attempts to get a title through FetchName, uses WMName otherwise
-// generally called with draw_title_on_frame
-char *get_title_of_window(Display *dsp, Window titled, char *ttl,
-        int *asc, int *desc, XFontStruct *font) {
-    int direction, ascent, descent;
-    XCharStruct overall;
+// width of a title in the title font, measured by xft only the first time
+// a string shows up (or after it got pushed out of its slot)
+int title_width(Display *dsp, Titles *ttls, const char *str) {
+    unsigned long h = hash_string(str);
+    Extent *ext = &ttls->extents[h % EXTENT_SLOTS];
+    if (ext->str != NULL && ext->hash == h && strcmp(ext->str, str) == 0) {
+        return ext->wid;
+    }
+    XGlyphInfo info;
+    XftTextExtentsUtf8(dsp, ttls->font, (const FcChar8 *)str, strlen(str), &info);
+    free(ext->str);
+    ext->hash = h;
+    ext->str = strdup(str);
+    ext->wid = info.xOff;
+    return ext->wid;
+}
 
-    XFetchName(dsp, titled, &ttl);
-    if (ttl == NULL) {
-        XTextProperty textp_return;
-        XGetWMName(dsp, titled, &textp_return);
-        ttl = textp_return.value;
-        if (ttl == NULL) {
-            ttl = "Armw Window";
+// how many bytes of text fit in room pixels with an ellipsis after them,
+// found by bisecting over utf-8 character boundaries
+int fit_title(Display *dsp, Titles *ttls, const char *text, int len, int room) {
+    XGlyphInfo info;
+    XftTextExtentsUtf8(dsp, ttls->font, (const FcChar8 *)"\u2026", strlen("\u2026"), &info);
+    room -= info.xOff;
+    int lo = 0;
+    int hi = len;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        while (mid > lo && (text[mid] & 0xc0) == 0x80) {
+            mid--; // back to the start of a character
+        }
+        if (mid == lo) {
+            // the character at lo runs past the middle, so try all of it
+            mid = lo + 1;
+            while (mid < hi && (text[mid] & 0xc0) == 0x80) {
+                mid++;
+            }
+        }
+        XftTextExtentsUtf8(dsp, ttls->font, (const FcChar8 *)text, mid, &info);
+        if (info.xOff <= room) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+            while (hi > lo && (text[hi] & 0xc0) == 0x80) {
+                hi--;
+            }
         }
     }
+    return lo;
+}
+
+// called in main loop, renders the cached title string into the title pixmap,
+// which only gets reallocated when the frame changed width
+void render_title(Display *dsp, Viewable *vwbl, Titles *ttls, int titleh, const char *text) {
+    int w = vwbl->fgeo.w;
+    if (vwbl->tpix == None || vwbl->tpw != w || vwbl->tph != titleh) {
+        free_title(dsp, vwbl);
+        vwbl->tpix = XCreatePixmap(dsp, vwbl->fram, w, titleh,
+                DefaultDepth(dsp, DefaultScreen(dsp)));
+        vwbl->txft = XftDrawCreate(dsp, vwbl->tpix, ttls->visual, ttls->cmap);
+        vwbl->tpw = w;
+        vwbl->tph = titleh;
+    }
+    XFillRectangle(dsp, vwbl->tpix, vwbl->fill, 0, 0, w, titleh);
+
+    // the width of the plain title is already known, a tab label gets looked up.
+    // only a title that doesn't fit has to be measured any further
+    int len = strlen(text);
+    int room = w - 4;
+    int tw = text == vwbl->ttl ? vwbl->twid : title_width(dsp, ttls, text);
+    if (tw > room) {
+        len = fit_title(dsp, ttls, text, len, room);
+    }
+    XftDrawStringUtf8(vwbl->txft, &ttls->fg, ttls->font, 2, ttls->font->ascent,
+            (const FcChar8 *)text, len);
+    if (len < (int)strlen(text)) {
+        XGlyphInfo info;
+        XftTextExtentsUtf8(dsp, ttls->font, (const FcChar8 *)text, len, &info);
+        XftDrawStringUtf8(vwbl->txft, &ttls->fg, ttls->font, 2 + info.xOff, ttls->font->ascent,
+                (const FcChar8 *)"\u2026", strlen("\u2026"));
+    }
+}
+
+// puts the rendered title at the bottom of the frame, this is all an expose costs
+void copy_title(Display *dsp, Viewable *vwbl) {
+    XCopyArea(dsp, vwbl->tpix, vwbl->fram, vwbl->gc, 0, 0, vwbl->tpw, vwbl->tph,
+            0, vwbl->fgeo.h - vwbl->tph);
+}
 
-    XTextExtents(font, ttl, strlen(ttl), &direction, &ascent, &descent, &overall);
-    *asc = ascent;
-    *desc = descent;
+// attempts to get a utf-8 title through _NET_WM_NAME, uses WM_NAME (converted from
+// whatever encoding it is in) otherwise. the returned string is malloc'd and belongs to the caller
+// WM_NAME can be in any encoding, this turns it into utf-8 without asking the server
+char *title_from_name(Display *dsp, XTextProperty *name) {
+    char **list = NULL;
+    int cnt = 0;
+    char *ttl;
+    if (Xutf8TextPropertyToTextList(dsp, name, &list, &cnt) >= Success
+            && cnt > 0 && list != NULL) {
+        ttl = strdup(list[0]);
+        XFreeStringList(list);
+    } else {
+        ttl = strndup((char *)name->value, name->nitems);
+    }
     return ttl;
 }
 
+char *get_title_of_window(Display *dsp, Window titled, Titles *ttls) {
+    char *ttl;
+    Atom type;
+    int format;
+    unsigned long n, after;
+    unsigned char *data = NULL;
+
+    if (XGetWindowProperty(dsp, titled, ttls->netName, 0, 1024, false,
+                ttls->utf8, &type, &format, &n, &after, &data) == Success && data != NULL) {
+        if (type == ttls->utf8 && format == 8 && n > 0) {
+            ttl = strndup((char *)data, n);
+            XFree(data);
+            return ttl;
+        }
+        XFree(data);
+    }
+
+    XTextProperty textp_return;
+    if (XGetWMName(dsp, titled, &textp_return) && textp_return.value != NULL) {
+        ttl = title_from_name(dsp, &textp_return);
+        XFree(textp_return.value);
+        return ttl;
+    }
+    return strdup("Armw Window");
+}
+
+
+// hands a Viewable its (already fetched) title, which it takes ownership of, and
+// recomputes its extents. returns true only if the text actually changed
+bool set_title(Display *dsp, Viewable *vwbl, Titles *ttls, char *ttl) {
+    if (vwbl->ttl != NULL && strcmp(ttl, vwbl->ttl) == 0) {
+        free(ttl);
+        return false;
+    }
+    free(vwbl->ttl);
+    vwbl->ttl = ttl;
+    vwbl->twid = title_width(dsp, ttls, ttl);
+    return true;
+}
+
+// caches the parts of WM_NORMAL_HINTS that matter for tiling, NULL if there are none
+void set_hints(Viewable *vwbl, XSizeHints *hints) {
+    vwbl->basew = vwbl->baseh = 0;
+    vwbl->incw = vwbl->inch = 0;
+    vwbl->minw = vwbl->minh = 0;
+    if (hints == NULL) {
+        return;
+    }
+    if (hints->flags & PBaseSize) {
+        vwbl->basew = hints->base_width;
+        vwbl->baseh = hints->base_height;
+    } else if (hints->flags & PMinSize) {
+        vwbl->basew = hints->min_width;
+        vwbl->baseh = hints->min_height;
+    }
+    if (hints->flags & PResizeInc) {
+        vwbl->incw = hints->width_inc;
+        vwbl->inch = hints->height_inc;
+    }
+    if (hints->flags & PMinSize) {
+        vwbl->minw = hints->min_width;
+        vwbl->minh = hints->min_height;
+    }
+}
+
+// what the adoption pass needs to know about a window that was there before us
+typedef struct Found Found;
+struct Found {
+    Window wndw;
+    char *ttl;
+    XSizeHints hints;
+    bool hntd; // has WM_NORMAL_HINTS
+};
+
+// finds the top-level windows that were mapped before we started, with their titles and
+// size hints. xlib can only wait for one reply at a time, so this goes through a short
+// lived xcb connection instead: every request goes out at once and the replies are
+// collected afterwards, which costs about one round trip however many windows there are.
+// windows we already have (frames from the last instance) are left out
+int fetch_existing(Display *dsp, Window root, Titles *ttls, Table *wins, Found **out) {
+    *out = NULL;
+    xcb_connection_t *xc = xcb_connect(DisplayString(dsp), NULL);
+    if (xcb_connection_has_error(xc)) {
+        LOG(LOG_WARN, "Could not look for existing windows");
+        xcb_disconnect(xc);
+        return 0;
+    }
+    xcb_query_tree_reply_t *tree = xcb_query_tree_reply(xc, xcb_query_tree(xc, root), NULL);
+    int n = tree != NULL ? xcb_query_tree_children_length(tree) : 0;
+    xcb_window_t *kids = tree != NULL ? xcb_query_tree_children(tree) : NULL;
+
+    xcb_get_window_attributes_cookie_t *attrs = malloc((n + 1) * sizeof(*attrs));
+    xcb_get_property_cookie_t *props = malloc((n + 1) * 3 * sizeof(*props));
+    for (int i = 0; i < n; i++) {
+        attrs[i] = xcb_get_window_attributes(xc, kids[i]);
+        props[i * 3] = xcb_get_property(xc, false, kids[i], ttls->netName, ttls->utf8, 0, 1024);
+        props[i * 3 + 1] = xcb_get_property(xc, false, kids[i], XA_WM_NAME,
+                XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+        props[i * 3 + 2] = xcb_get_property(xc, false, kids[i], XA_WM_NORMAL_HINTS,
+                XA_WM_SIZE_HINTS, 0, 18);
+    }
+    xcb_flush(xc);
+
+    Found *found = calloc(n + 1, sizeof(Found));
+    int nfound = 0;
+    for (int i = 0; i < n; i++) {
+        xcb_get_window_attributes_reply_t *attr = xcb_get_window_attributes_reply(xc, attrs[i], NULL);
+        xcb_get_property_reply_t *net = xcb_get_property_reply(xc, props[i * 3], NULL);
+        xcb_get_property_reply_t *name = xcb_get_property_reply(xc, props[i * 3 + 1], NULL);
+        xcb_get_property_reply_t *hnts = xcb_get_property_reply(xc, props[i * 3 + 2], NULL);
+
+        // only what a client would have asked us to map: no popups, nothing hidden
+        if (attr != NULL && !attr->override_redirect && attr->map_state == XCB_MAP_STATE_VIEWABLE
+                && table_find(wins, kids[i]) == -1) {
+            Found *f = &found[nfound++];
+            f->wndw = kids[i];
+            // same order of preference as get_title_of_window
+            if (net != NULL && net->type == ttls->utf8 && net->format == 8 && net->value_len > 0) {
+                f->ttl = strndup(xcb_get_property_value(net), net->value_len);
+            } else if (name != NULL && name->type != None && name->value_len > 0) {
+                XTextProperty tp = { xcb_get_property_value(name), name->type, name->format,
+                    name->value_len };
+                f->ttl = title_from_name(dsp, &tp);
+            } else {
+                f->ttl = strdup("Armw Window");
+            }
+            // the wire format of WM_SIZE_HINTS, older clients leave off the base size
+            if (hnts != NULL && hnts->format == 32 && hnts->value_len >= 15) {
+                uint32_t *d = xcb_get_property_value(hnts);
+                f->hntd = true;
+                f->hints.flags = d[0];
+                f->hints.min_width = d[5];
+                f->hints.min_height = d[6];
+                f->hints.width_inc = d[9];
+                f->hints.height_inc = d[10];
+                if (hnts->value_len >= 18) {
+                    f->hints.base_width = d[15];
+                    f->hints.base_height = d[16];
+                } else {
+                    f->hints.flags &= ~PBaseSize;
+                }
+            }
+        }
+        free(attr);
+        free(net);
+        free(name);
+        free(hnts);
+    }
+    free(attrs);
+    free(props);
+    free(tree);
+    xcb_disconnect(xc);
+    *out = found;
+    return nfound;
+}
+
+// marks the clients from the last instance's snapshot that went away before we were
+// listening to them, and returns how many. like fetch_existing it asks about all of them
+// at once on a short lived xcb connection, so it costs about one round trip
+int find_gone(Display *dsp, Table *wins, bool *gone) {
+    xcb_connection_t *xc = xcb_connect(DisplayString(dsp), NULL);
+    if (xcb_connection_has_error(xc)) {
+        LOG(LOG_WARN, "Could not check the windows from the last instance");
+        xcb_disconnect(xc);
+        return 0;
+    }
+    xcb_get_window_attributes_cookie_t *attrs = malloc((wins->used + 1) * sizeof(*attrs));
+    for (int i = 0; i < wins->used; i++) {
+        if (wins->vwbls[i].wndw != 0) {
+            attrs[i] = xcb_get_window_attributes(xc, wins->vwbls[i].wndw);
+        }
+    }
+    xcb_flush(xc);
+
+    int ngone = 0;
+    for (int i = 0; i < wins->used; i++) {
+        if (wins->vwbls[i].wndw == 0) {
+            continue;
+        }
+        xcb_get_window_attributes_reply_t *attr = xcb_get_window_attributes_reply(xc, attrs[i], NULL);
+        gone[i] = attr == NULL;
+        ngone += gone[i];
+        free(attr);
+    }
+    free(attrs);
+    xcb_disconnect(xc);
+    return ngone;
+}
+
+bool fetch_push(FetchRing *ring, Fetch *job) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= FETCH_SLOTS) {
+        return false;
+    }
+    ring->jobs[head % FETCH_SLOTS] = *job;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool fetch_pop(FetchRing *ring, Fetch *job) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+        return false;
+    }
+    *job = ring->jobs[tail % FETCH_SLOTS];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// does the actual read, on whichever connection it's given
+void fetch_run(Display *dsp, Fetch *job) {
+    job->ok = false;
+    if (job->kind == F_TITLE) {
+        job->ttl = get_title_of_window(dsp, job->wndw, fetcher.ttls);
+    } else if (job->kind == F_HINTS) {
+        long supplied;
+        job->ok = XGetWMNormalHints(dsp, job->wndw, &job->hints, &supplied);
+    } else if (job->kind == F_PROTOCOLS) {
+        Atom *protos;
+        int n;
+        job->prot = P_KNOWN;
+        if (XGetWMProtocols(dsp, job->wndw, &protos, &n)) {
+            for (int i = 0; i < n; i++) {
+                if (protos[i] == fetcher.delete) { job->prot |= P_DELETE; }
+                if (protos[i] == fetcher.ping) { job->prot |= P_PING; }
+            }
+            XFree(protos);
+        }
+    }
+}
+
+void *fetch_worker(void *arg) {
+    uint64_t n;
+    while (read(fetcher.wake, &n, sizeof(n)) == sizeof(n) || errno == EINTR) {
+        Fetch job;
+        while (fetch_pop(&fetcher.todo, &job)) {
+            fetch_run(fetcher.dsp, &job);
+#ifdef ARMW_BENCH
+            atomic_store_explicit(&fetcher.sent, NextRequest(fetcher.dsp) - 1,
+                    memory_order_relaxed);
+#endif
+            while (!fetch_push(&fetcher.done, &job)) {
+                usleep(1000); // the event loop is behind, it'll make room
+            }
+            uint64_t one = 1;
+            if (write(fetcher.back, &one, sizeof(one)) < 0) {
+                // the event loop still picks it up next time it's idle
+            }
+        }
+    }
+    return NULL;
+}
+
+// starts the worker on its own connection. without one, the reads are done by
+// the event loop itself, which is slower but works the same
+void fetch_init(Display *dsp, Titles *ttls, Atom delete, Atom ping) {
+    fetcher.ttls = ttls;
+    fetcher.delete = delete;
+    fetcher.ping = ping;
+    fetcher.wake = eventfd(0, EFD_CLOEXEC);
+    fetcher.back = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    fetcher.dsp = XOpenDisplay(DisplayString(dsp));
+    if (fetcher.dsp != NULL) {
+        fcntl(ConnectionNumber(fetcher.dsp), F_SETFD, FD_CLOEXEC);
+    }
+    pthread_t thr;
+    if (fetcher.dsp == NULL || fetcher.wake == -1 || fetcher.back == -1
+            || pthread_create(&thr, NULL, fetch_worker, NULL) != 0) {
+        LOG(LOG_WARN, "Could not start the fetch worker, property reads will block");
+        if (fetcher.dsp != NULL) {
+            XCloseDisplay(fetcher.dsp);
+            fetcher.dsp = NULL;
+        }
+    }
+}
+
+// asks for a property of a client, the answer comes back through fetcher.done.
+// only one read of each kind is underway per client, a change in the meantime
+// just has it read again once the answer is in. a read that doesn't fit in the
+// ring is never lost, it waits in fdly for fetch_retry. false if it had to wait
+bool fetch_property(Display *dsp, Viewable *vwbl, int kind) {
+    int bit = 1 << kind;
+    if (vwbl->fpnd & bit) {
+        vwbl->fagn |= bit;
+        return true;
+    }
+    FetchRing *ring = fetcher.dsp == NULL ? &fetcher.done : &fetcher.todo;
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= FETCH_SLOTS) {
+        vwbl->fdly |= bit;
+        fetcher.behind = true;
+        return false;
+    }
+    Fetch job = { .kind = kind, .wndw = vwbl->wndw };
+    if (fetcher.dsp == NULL) {
+        fetch_run(dsp, &job);
+    }
+    fetch_push(ring, &job); // only the event loop pushes, so the room is still there
+    vwbl->fpnd |= bit;
+    return true;
+}
+
+// asks again for the reads that had to wait, now that answers have made room.
+// true if any of them got in
+bool fetch_retry(Display *dsp, Table *wins) {
+    bool moved = false;
+    fetcher.behind = false;
+    for (int i = 0; i < wins->used; i++) {
+        Viewable *vwbl = &wins->vwbls[i];
+        int late = vwbl->fdly;
+        vwbl->fdly = 0;
+        for (int kind = 0; kind < F_KINDS; kind++) {
+            if ((late & (1 << kind)) && fetch_property(dsp, vwbl, kind)) {
+                moved = true;
+            }
+        }
+    }
+    return moved;
+}
+
+// called when the event queue runs dry, hands whatever was asked for to the worker
+void fetch_kick() {
+    unsigned int head = atomic_load_explicit(&fetcher.todo.head, memory_order_relaxed);
+    if (fetcher.dsp == NULL || head == fetcher.kicked) {
+        return;
+    }
+    fetcher.kicked = head;
+    uint64_t one = 1;
+    if (write(fetcher.wake, &one, sizeof(one)) < 0) {
+        LOG(LOG_WARN, "Could not wake the fetch worker: %s", strerror(errno));
+    }
+}
+
+// the worker has answers. this only clears the eventfd, they are handled by the
+// event loop (along with everything else that waits for the queue to be drained)
+void fetch_ready(int fd, void *data) {
+    uint64_t n;
+    if (read(fd, &n, sizeof(n)) < 0) {
+        // nothing to clear
+    }
+}
+
+// sends a WM_PROTOCOLS message, the window goes in l[2] because _NET_WM_PING wants it there
+void send_protocol(Pings *pings, Window w, Atom proto, Time when) {
+    XEvent msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.xclient.type = ClientMessage;
+    msg.xclient.message_type = pings->protocols;
+    msg.xclient.window = w;
+    msg.xclient.format = 32;
+    msg.xclient.data.l[0] = proto;
+    msg.xclient.data.l[1] = when;
+    msg.xclient.data.l[2] = w;
+    XSendEvent(pings->dsp, w, false, NoEventMask, &msg);
+}
+
+// the client answered the ping (or is gone), so it's left alone. free slots hold
+// None, so a pong that doesn't say which window it's for matches nothing
+void ping_answered(Pings *pings, Window w) {
+    if (w == None) {
+        return;
+    }
+    for (int k = 0; k < MAX_PINGS; k++) {
+        if (pings->slots[k].wndw == w) {
+            cancel_timer(pings->loop, pings->slots[k].tmr);
+            pings->slots[k].wndw = None;
+            pings->slots[k].tmr = -1;
+        }
+    }
+}
+
+// a client that was asked to close never answered the ping, so it's hung: kill it
+void ping_expired(void *data) {
+    Ping *ping = data;
+    LOG(LOG_INFO, "Window %lu didn't answer the ping, killing it", ping->wndw);
+    XKillClient(ping->all->dsp, ping->wndw);
+    XFlush(ping->all->dsp);
+    ping->wndw = None;
+    ping->tmr = -1;
+}
+
+// kills the window in the best way possible, with nothing waited on. a client that takes
+// WM_DELETE_WINDOW gets to close itself (and ask the user first, if it wants to), but if
+// it also takes _NET_WM_PING and doesn't answer that in time, it's killed anyway
+void close_client(Pings *pings, Window w, int prot, Time when) {
+    if (!(prot & P_DELETE)) {
+        LOG(LOG_DEBUG, "Killing window: %lu", w);
+        XKillClient(pings->dsp, w);
+        return;
+    }
+    LOG(LOG_DEBUG, "Sending WM_DELETE_WINDOW to window: %lu", w);
+    send_protocol(pings, w, pings->delete, when);
+    if (!(prot & P_PING)) {
+        return;
+    }
+    ping_answered(pings, w); // closing twice only restarts the clock
+    for (int k = 0; k < MAX_PINGS; k++) {
+        Ping *ping = &pings->slots[k];
+        if (ping->wndw == None) {
+            ping->tmr = add_timer(pings->loop, PING_MS, ping_expired, ping);
+            if (ping->tmr != -1) {
+                ping->wndw = w;
+                send_protocol(pings, w, pings->ping, when);
+            }
+            return;
+        }
+    }
+    LOG(LOG_WARN, "Too many closes underway, not pinging %lu", w);
+}
+
+// configures the dragged client for wherever the pointer is now
+void drag_apply(Drag *drag) {
+    drag->dirty = false;
+    drag->last = now_ms();
+    int i = table_find(drag->wins, drag->wndw);
+    if (i == -1 || drag->wins->vwbls[i].wndw != drag->wndw) {
+        drag->wndw = None; // it went away halfway through
+        return;
+    }
+    Viewable *vwbl = &drag->wins->vwbls[i];
+    int dx = drag->x - drag->x0;
+    int dy = drag->y - drag->y0;
+    Geom fg = drag->fg0;
+    Geom wg = drag->wg0;
+    if (drag->button == Button1) {
+        move_resize(drag->be, vwbl->fram, &vwbl->fgeo, &vwbl->fser,
+                fg.x + dx, fg.y + dy, fg.w, fg.h);
+    } else {
+        // the frame grows with the client, so the hints decide for both
+        int w = wg.w + dx > 1 ? wg.w + dx : 1;
+        int h = wg.h + dy > 1 ? wg.h + dy : 1;
+        apply_hints(vwbl, &w, &h);
+        move_resize(drag->be, vwbl->wndw, &vwbl->wgeo, &vwbl->wser, wg.x, wg.y, w, h);
+        move_resize(drag->be, vwbl->fram, &vwbl->fgeo, &vwbl->fser,
+                fg.x, fg.y, fg.w + w - wg.w, fg.h + h - wg.h);
+    }
+    XFlush(drag->dsp);
+}
+
+void drag_tick(void *data) {
+    Drag *drag = data;
+    drag->tmr = -1;
+    if (drag->dirty && drag->wndw != None) {
+        drag_apply(drag);
+    }
+}
+
+// the pointer moved. there's at most one configure per refresh of the screen, anything
+// in between only moves where the next one goes, and the last position always gets sent
+void drag_motion(Drag *drag, int x, int y) {
+    drag->x = x;
+    drag->y = y;
+    drag->dirty = true;
+    unsigned long long next = drag->last + 1000 / drag->outs->hz;
+    unsigned long long now = now_ms();
+    if (now >= next) {
+        cancel_timer(drag->loop, drag->tmr);
+        drag->tmr = -1;
+        drag_apply(drag);
+    } else if (drag->tmr == -1) {
+        drag->tmr = add_timer(drag->loop, next - now, drag_tick, drag);
+    }
+}
+
+// let go: wherever the pointer is now is where it ends up
+void drag_end(Drag *drag, int x, int y) {
+    cancel_timer(drag->loop, drag->tmr);
+    drag->tmr = -1;
+    drag->x = x;
+    drag->y = y;
+    drag_apply(drag);
+    drag->wndw = None;
+}
+
+// tells a client where it really is (in root coordinates), as ICCCM wants
+// whenever we answer a ConfigureRequest
+void send_configure_notify(Display *dsp, Viewable *vwbl) {
+    XConfigureEvent ce;
+    memset(&ce, 0, sizeof(ce));
+    ce.type = ConfigureNotify;
+    ce.display = dsp;
+    ce.event = vwbl->wndw;
+    ce.window = vwbl->wndw;
+    ce.x = vwbl->fgeo.x + 2 + vwbl->wgeo.x;
+    ce.y = vwbl->fgeo.y + 2 + vwbl->wgeo.y;
+    ce.width = vwbl->wgeo.w;
+    ce.height = vwbl->wgeo.h;
+    ce.border_width = 0;
+    ce.above = None;
+    ce.override_redirect = false;
+    XSendEvent(dsp, vwbl->wndw, false, StructureNotifyMask, (XEvent *)&ce);
+}
+
+// whether e is another ConfigureRequest for the same window
+bool same_configure_request(XEvent *e, Window w) {
+    return e->type == ConfigureRequest && e->xconfigurerequest.window == w;
+}
+
+// folds a later ConfigureRequest into an earlier one, the later values win
+void merge_configure_request(XConfigureRequestEvent *into, XConfigureRequestEvent *from) {
+    if (from->value_mask & CWX) { into->x = from->x; }
+    if (from->value_mask & CWY) { into->y = from->y; }
+    if (from->value_mask & CWWidth) { into->width = from->width; }
+    if (from->value_mask & CWHeight) { into->height = from->height; }
+    if (from->value_mask & CWBorderWidth) { into->border_width = from->border_width; }
+    if (from->value_mask & CWSibling) { into->above = from->above; }
+    if (from->value_mask & CWStackMode) { into->detail = from->detail; }
+    into->value_mask |= from->value_mask;
+}
+
+// figures out which modifier NumLock is on, it differs between keyboards
+unsigned int find_numlock(Display *dsp) {
+    unsigned int mask = 0;
+    XModifierKeymap *mods = RT(RT_MODMAP, XGetModifierMapping(dsp));
+    KeyCode numlock = XKeysymToKeycode(dsp, XK_Num_Lock);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < mods->max_keypermod; j++) {
+            if (numlock != 0 && mods->modifiermap[i * mods->max_keypermod + j] == numlock) {
+                mask = 1 << i;
+            }
+        }
+    }
+    XFreeModifiermap(mods);
+    return mask;
+}
+
+// builds the lookup table and grabs every binding (and the mouse buttons)
+// in all their lock-modifier variants,
+// all in one go without waiting on the server in between
+void grab_bindings(Display *dsp, Window root, Keys *keys) {
+    memset(keys->map, -1, sizeof(keys->map));
+    keys->numlock = find_numlock(dsp);
+    unsigned int locks[] = { 0, LockMask, keys->numlock, LockMask | keys->numlock };
+
+    XUngrabKey(dsp, AnyKey, AnyModifier, root);
+    for (int b = 0; b < NBINDINGS; b++) {
+        KeyCode code = XKeysymToKeycode(dsp, bindings[b].sym);
+        if (code == 0) {
+            continue;
+        }
+        keys->map[code][bindings[b].mods & MOD_MASKS & ~keys->numlock] = b;
+        for (int l = 0; l < 4; l++) {
+            XGrabKey(dsp, code, bindings[b].mods | locks[l], root, true,
+                    GrabModeAsync, GrabModeAsync);
+        }
+    }
+
+    // mod+left/right drags. the press starts a pointer grab on root that lasts
+    // until the button is let go, so the whole drag is reported to us
+    XUngrabButton(dsp, AnyButton, AnyModifier, root);
+    unsigned int buttons[] = { Button1, Button3 };
+    for (int b = 0; b < 2; b++) {
+        for (int l = 0; l < 4; l++) {
+            XGrabButton(dsp, buttons[b], Mod1Mask | locks[l], root, false,
+                    ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
+                    GrabModeAsync, GrabModeAsync, None, None);
+        }
+    }
+    XFlush(dsp);
+}
+
+// the binding a key event triggers, or NULL, ignoring CapsLock and NumLock
+const Binding *find_binding(Keys *keys, XKeyEvent *key) {
+    int b = keys->map[key->keycode & 0xff][key->state & MOD_MASKS & ~keys->numlock];
+    return b == -1 ? NULL : &bindings[b];
+}
+
+// whether e is a press or release of the same key with the same modifiers
+bool same_key(XEvent *e, XKeyEvent *key) {
+    return (e->type == KeyPress || e->type == KeyRelease)
+        && e->xkey.keycode == key->keycode && e->xkey.state == key->state;
+}
+
+// swallows the auto-repeats of a held key queued right behind it and returns the
+// total distance to move by. every folded repeat accelerates just like a separately
+// handled one would, so holding a key ends up in the same place, just without the backlog.
+// the first other event ends the run, whatever comes after it is handled in order
+int fold_repeats(Display *dsp, XKeyEvent *key, int *kcnt) {
+    int total = *kcnt;
+    XEvent more;
+    while (XPending(dsp) > 0) {
+        XPeekEvent(dsp, &more);
+        if (!same_key(&more, key)) {
+            break;
+        }
+        XNextEvent(dsp, &more);
+        if (more.type == KeyPress) {
+            if (*kcnt < KEY_MAX_STEP) { (*kcnt)++; }
+            total += *kcnt;
+        }
+    }
+    return total;
+}
+
+// with ARMW_RECORD set, the events that drive the layout go into a trace that
+// armw-replay runs again without a server, one line each. moving and resizing
+// frames by hand doesn't touch the trees, so it's left out, but the focus a mod+click
+// picks does decide where the next split goes
+void record_event(FILE *rec, XEvent *e, Keys *keys, Table *wins, bool resizing, bool dragging) {
+    if (e->type == MapRequest && table_find(wins, e->xmaprequest.window) == -1) {
+        fprintf(rec, "map %lu\n", e->xmaprequest.window);
+    } else if (e->type == DestroyNotify) {
+        int i = table_find(wins, e->xdestroywindow.window);
+        if (i != -1 && wins->vwbls[i].wndw == e->xdestroywindow.window) {
+            fprintf(rec, "destroy %lu\n", e->xdestroywindow.window);
+        }
+    } else if (e->type == ButtonPress && !dragging) {
+        int i = table_find(wins, e->xbutton.subwindow);
+        if (i != -1 && wins->vwbls[i].fram == e->xbutton.subwindow) {
+            fprintf(rec, "pick %lu\n", wins->vwbls[i].wndw);
+        }
+    } else if (e->type == KeyPress) {
+        const Binding *bind = find_binding(keys, &e->xkey);
+        if (bind == NULL) {
+            return;
+        }
+        int arg = bind->arg;
+        switch (bind->act) {
+            case A_FOCUS:  if (!resizing) { fprintf(rec, "focus %d\n", arg); } break;
+            case A_TILE:   fprintf(rec, "tile %d\n", arg); break;
+            case A_VIEW:   fprintf(rec, "view %d\n", arg); break;
+            case A_SEND:   fprintf(rec, "send %d\n", arg); break;
+            case A_TABBED: fprintf(rec, "tabbed\n"); break;
+            case A_TAB:    fprintf(rec, "tab\n"); break;
+            case A_OUTPUT: fprintf(rec, "output %d\n", arg); break;
+        }
+    }
+}
+
 // called when mapping window, used to add parent frame to show title, have border, etc
-// gets title and stores it in the frame (not really used), but does not actually draw
-// the title on the frame
-Window add_frame_to_window(Display *dsp, Window root, Window toFrame,
-        XWindowAttributes attrs, XFontStruct *font) {
-    int ascent, descent;
-    char *title;
-    title = get_title_of_window(dsp, toFrame, title, &ascent, &descent, font);
-    Window frame = XCreateSimpleWindow(
-            dsp, root, attrs.x, attrs.y,
-            attrs.width - 4, attrs.height - 4, 2, 0x7cafc2, 0x181818);
+// the title and hints have to be in the Viewable already, the title isn't drawn yet
+Window add_frame_to_window(Display *dsp, Backend *be, Window root, Viewable *vwbl,
+        Geom area, int titleh, Pen *pens, FramePool *pool) {
+    Window toFrame = vwbl->wndw;
+    Geom fg, wg;
+    tile_geoms(area, titleh, &fg, &wg);
+    apply_hints(vwbl, &wg.w, &wg.h);
+    // a recycled frame may still have notifies from its last client in flight,
+    // the serial move_resize records makes sure those get ignored
+    Window frame = pool_take(dsp, root, pool);
+    vwbl->gc = get_pen(dsp, root, pens, 0x181818, 0x7cafc2, None);
+    vwbl->fill = get_pen(dsp, root, pens, 0x181818, 0x181818, None);
+    move_resize(be, frame, &vwbl->fgeo, &vwbl->fser, fg.x, fg.y, fg.w, fg.h);
 
     XReparentWindow(dsp, toFrame, frame, 0, 0);
-    XSelectInput(dsp, frame,
-            SubstructureRedirectMask | SubstructureNotifyMask
-            | PropertyChangeMask | EnterWindowMask | FocusChangeMask);
-    XMoveResizeWindow(dsp, toFrame,
-            0, 0,
-            attrs.width - 4, attrs.height - 4 - (ascent + descent));
+    // should we ever die with the frames, the client goes back to the root instead of with them
+    XAddToSaveSet(dsp, toFrame);
+    // we want to hear about title changes on the client itself
+    XSelectInput(dsp, toFrame, PropertyChangeMask);
+    move_resize(be, toFrame, &vwbl->wgeo, &vwbl->wser,
+            wg.x, wg.y, wg.w, wg.h);
 
     XMapWindow(dsp, frame);
     XMapWindow(dsp, toFrame);
@@ -124,577 +1646,763 @@ Window add_frame_to_window(Display *dsp, Window root, Window toFrame,
 }
 
 // contains variable decls
-int main() {
+int main(int argc, char **argv) {
+    unsigned long long start = now_us();
     srand(time(NULL)); // seed the rng for window positioning
-    XWindowAttributes attrs;
-    Viewable vwbls[MAX_WINS]; // create array of Viewables for organization
-    // and set all viewables to 0
-    for (int i = 0; i < MAX_WINS; i++) {
-        vwbls[i].wndw = 0;
-        vwbls[i].fram = 0;
-        vwbls[i].left = -1;
-        vwbls[i].rite = -1;
-        vwbls[i].topp = -1;
-        vwbls[i].botm = -1;
-    }
+    XInitThreads(); // the fetch worker uses xlib too, on a connection of its own
+
+    // signals we care about are read through a signalfd in the main loop, so they
+    // have to be blocked before any thread (the log writer) gets started
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGUSR1);
+    sigaddset(&sigs, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &sigs, NULL);
+    log_init();
+    Table wins; // create table of Viewables for organization
+    table_init(&wins);
+    // and the split trees that lay them out, one per workspace
+    Workspace spaces[NSPACES];
+    spaces_init(spaces);
+    int cur = 0;
+    Tree *tree = &spaces[cur].trees[0]; // the one with the focus
 
     // initialize display and root window
     Display *dsp = XOpenDisplay(0);
     Window root = DefaultRootWindow(dsp);
+    // errors only get logged, windows can go away at any time (even during startup)
+    XSetErrorHandler(&handle_error);
+    // launched programs must not inherit our connection to the server
+    fcntl(ConnectionNumber(dsp), F_SETFD, FD_CLOEXEC);
+    // everything the layout code wants done to windows comes through here
+    Backend be = { dsp, x_configure, x_map, x_unmap, x_focus };
 
-    // get display geometry for random calculations
-    int dispW, dispH, dispX, dispY, dispBW, dispZ;
-    XGetGeometry(dsp, root, &root,
-            &dispX, &dispY,
-            &dispW, &dispH,
-            &dispBW, &dispZ);
-    printf("Display dimensions: %dx%d\n", dispW, dispH);
+    // get the output geometry once, randr tells us when it changes
+    Outputs outs;
+    memset(&outs, 0, sizeof(outs));
+    outs.evb = -1;
+#ifdef XRANDR
+    int rrErr;
+    if (XRRQueryExtension(dsp, &outs.evb, &rrErr)) {
+        XRRSelectInput(dsp, root, RRScreenChangeNotifyMask);
+    } else {
+        outs.evb = -1;
+    }
+#endif
+    query_outputs(dsp, root, &outs);
+
+    // coming back from an in-place restart (see A_RESTART), the last instance left
+    // its state in a memfd. the trees keep the areas they had, so only outputs that
+    // changed in the meantime get laid out again
+    bool restored = false;
+    char *state = getenv("ARMW_STATE");
+    if (state != NULL) {
+        FILE *f = fdopen(atoi(state), "r");
+        unsetenv("ARMW_STATE");
+        restored = f != NULL && load_state(f, &wins, spaces, &cur);
+        if (!restored) {
+            LOG(LOG_WARN, "Could not read the state left by the last instance");
+            release_clients(dsp, root, &wins);
+            table_init(&wins);
+            spaces_init(spaces);
+            cur = 0;
+        }
+        if (f != NULL) {
+            fclose(f);
+        }
+    }
+    for (int n = 0; n < NSPACES; n++) {
+        for (int m = 0; m < outs.n; m++) {
+            if (spaces[n].trees[m].root == -1) {
+                spaces[n].trees[m].area = outs.area[m];
+            }
+        }
+    }
 
     // set input masks for the root window so we can get events
     XSelectInput(dsp, root,
             SubstructureRedirectMask | SubstructureNotifyMask |
-            PropertyChangeMask | 0);
+            StructureNotifyMask | PropertyChangeMask | 0);
 
     XSetInputFocus(dsp, root, RevertToPointerRoot, CurrentTime);
 
-    // intern some atoms so we can change and compare them later
-    Atom WM_PROTOCOLS     = XInternAtom(dsp, "WM_PROTOCOLS", false);
-    Atom WM_DELETE_WINDOW = XInternAtom(dsp, "WM_DELETE_WINDOW", false);
-    Atom WM_SUPP_CHECK    = XInternAtom(dsp, "_NET_SUPPORTING_WM_CHECK", false);
-    Atom WM_NAME          = XInternAtom(dsp, "_NET_WM_NAME", false);
-    Atom UTF8_STR         = XInternAtom(dsp, "UTF8_STRING", false);
+    // intern all the atoms we change and compare later in one go,
+    // the requests go out back to back and only the last reply is waited for
+    char *atomNames[] = { "WM_PROTOCOLS", "WM_DELETE_WINDOW", "_NET_SUPPORTING_WM_CHECK",
+        "_NET_WM_NAME", "UTF8_STRING", "_ARMW_STATS", "_NET_WM_PING" };
+    Atom atoms[sizeof(atomNames) / sizeof(atomNames[0])];
+    XInternAtoms(dsp, atomNames, sizeof(atomNames) / sizeof(atomNames[0]), false, atoms);
+    Atom WM_PROTOCOLS     = atoms[0];
+    Atom WM_DELETE_WINDOW = atoms[1];
+    Atom WM_SUPP_CHECK    = atoms[2];
+    Atom WM_NAME          = atoms[3];
+    Atom UTF8_STR         = atoms[4];
+    Atom NET_WM_PING      = atoms[6];
     XChangeProperty(dsp, root, WM_SUPP_CHECK, XA_WINDOW, 32, PropModeReplace, (unsigned char *)&root,  1);
     XChangeProperty(dsp, root, WM_NAME,       UTF8_STR,  8,  PropModeReplace, (unsigned char *)"Armw", 5);
 
-    // compute keycodes for necessary keys
-    const int K_opabe = XKeysymToKeycode(dsp, ' ');
-    const int K_h     = XKeysymToKeycode(dsp, 'h');
-    const int K_j     = XKeysymToKeycode(dsp, 'j');
-    const int K_k     = XKeysymToKeycode(dsp, 'k');
-    const int K_l     = XKeysymToKeycode(dsp, 'l');
-    const int K_r     = XKeysymToKeycode(dsp, 'r');
-    const int K_q     = XKeysymToKeycode(dsp, 'q');
-    const int K_d     = XKeysymToKeycode(dsp, 'd');
-    const int K_e     = XKeysymToKeycode(dsp, 'e');
-    const int K_b     = XKeysymToKeycode(dsp, 'b');
-    const int K_v     = XKeysymToKeycode(dsp, 'v');
-
-    // add error handler and send request to server
-    XSetErrorHandler(&handle_error);
-    XSync(dsp, false);
-
-    // load font for window titles
-    XFontStruct *font = XLoadQueryFont(dsp, "fixed");
-
-    // grab mod+space for raising
-    XGrabKey(dsp, K_opabe,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // grab mod+r for resize toggle
-    XGrabKey(dsp, K_r,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // grab buttons for switching focus
-    XGrabKey(dsp, K_h,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_j,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_k,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_l,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-
-    // grab buttons for moving
-    XGrabKey(dsp, K_h,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_j,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_k,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_l,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // grab mod+mouse for focus
-    XGrabButton(dsp, 1, Mod1Mask, root, true,
-            ButtonPressMask, GrabModeAsync,
-            GrabModeAsync, None, None);
-
-    // grab mod+shift+q for closing windows
-    XGrabKey(dsp, K_q,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // mod+shift+e for closing wm
-    XGrabKey(dsp, K_e,
-            Mod1Mask | ShiftMask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // grab mod+d for dmenu
-    XGrabKey(dsp, K_d,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-
-    // grab keys for changing tiling style
-    XGrabKey(dsp, K_b,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
-    XGrabKey(dsp, K_v,
-            Mod1Mask, root, true,
-            GrabModeAsync, GrabModeAsync);
+    // held keys only repeat KeyPress, without a KeyRelease in between every time
+    XkbSetDetectableAutoRepeat(dsp, true, NULL);
+
+    // send everything so far to the server, errors go to handle_error
+    RT(RT_SYNC, XSync(dsp, false));
+
+    // load font for window titles, falling back to whatever fontconfig likes if ours is missing
+    int scr = DefaultScreen(dsp);
+    Titles ttls;
+    memset(&ttls, 0, sizeof(ttls));
+    ttls.visual = DefaultVisual(dsp, scr);
+    ttls.cmap = DefaultColormap(dsp, scr);
+    ttls.netName = WM_NAME;
+    ttls.utf8 = UTF8_STR;
+    ttls.font = XftFontOpenName(dsp, scr, TITLE_FONT);
+    if (ttls.font == NULL) {
+        LOG(LOG_WARN, "Could not open font %s", TITLE_FONT);
+        ttls.font = XftFontOpenName(dsp, scr, "sans");
+    }
+    XRenderColor fgc = { 0x7c7c, 0xafaf, 0xc2c2, 0xffff };
+    XftColorAllocValue(dsp, ttls.visual, ttls.cmap, &fgc, &ttls.fg);
+    // client properties are read on another connection, by another thread
+    fetch_init(dsp, &ttls, WM_DELETE_WINDOW, NET_WM_PING);
+    // height of the title strip at the bottom of every frame
+    int titleh = ttls.font->ascent + ttls.font->descent;
 
+    // grab every key binding, see the bindings table, and mod+mouse for dragging
+    Keys keys;
+    grab_bindings(dsp, root, &keys);
 
     // final variable declarations
     int subw = -1;
     int kcnt = 2;
     int filled = 0;
     bool resizing = false;
-    unsigned long ltime = time(NULL);
-    int count = 0;
+    unsigned long long ltime = now_ms();
     bool tilingVertically = false;
+    Pen pens[MAX_PENS];
+    memset(pens, 0, sizeof(pens));
+    FramePool pool;
+    pool.n = 0;
+    pool_fill(dsp, root, &pool);
+#ifdef ARMW_BENCH
+    Atom ARMW_REQS = XInternAtom(dsp, "_ARMW_REQUESTS", false);
+    unsigned long reqOwn = 1; // the intern above
+    unsigned long reqLast = 0;
+#endif
+    Loop loop;
+    memset(&loop, 0, sizeof(loop));
+    Pings pings;
+    memset(&pings, 0, sizeof(pings));
+    pings.dsp = dsp;
+    pings.loop = &loop;
+    pings.protocols = WM_PROTOCOLS;
+    pings.delete = WM_DELETE_WINDOW;
+    pings.ping = NET_WM_PING;
+    for (int k = 0; k < MAX_PINGS; k++) {
+        pings.slots[k].all = &pings;
+        pings.slots[k].tmr = -1;
+    }
+    Drag drag;
+    memset(&drag, 0, sizeof(drag));
+    drag.dsp = dsp;
+    drag.be = &be;
+    drag.wins = &wins;
+    drag.loop = &loop;
+    drag.outs = &outs;
+    drag.tmr = -1;
+
+    // take over the windows from the snapshot exactly as they are: the frames are still
+    // there and still hold their clients, we only have to listen to them again.
+    // no reframing, no configures. clients that quit before we were listening never
+    // get a DestroyNotify to us, so once the selects are in, the server is asked
+    // which ones are still there, and the rest are dropped as if it had come
+    if (restored) {
+        for (int n = 0; n < NSPACES; n++) {
+            for (int m = 0; m < MAX_OUTPUTS; m++) {
+                spaces[n].trees[m].live = n == cur;
+            }
+        }
+        for (int i = 0; i < wins.used; i++) {
+            Viewable *vwbl = &wins.vwbls[i];
+            if (vwbl->wndw == 0) {
+                continue;
+            }
+            XSelectInput(dsp, vwbl->wndw, PropertyChangeMask);
+            XSelectInput(dsp, vwbl->fram, FRAME_EVENTS);
+            XAddToSaveSet(dsp, vwbl->wndw);
+            vwbl->gc = get_pen(dsp, root, pens, 0x181818, 0x7cafc2, None);
+            vwbl->fill = get_pen(dsp, root, pens, 0x181818, 0x181818, None);
+            vwbl->twid = title_width(dsp, &ttls, vwbl->ttl);
+            table_index(&wins, vwbl->wndw, i);
+            table_index(&wins, vwbl->fram, i);
+            table_mark_title(&wins, i);
+            fetch_property(dsp, vwbl, F_PROTOCOLS);
+            filled++;
+        }
+        RT(RT_SYNC, XSync(dsp, false));
+        subw = spaces[cur].subw;
+        bool *gone = calloc(wins.used + 1, sizeof(bool));
+        if (find_gone(dsp, &wins, gone) > 0) {
+            for (int i = 0; i < wins.used; i++) {
+                if (gone[i]) {
+                    LOG(LOG_INFO, "Window %lu went away during the restart", wins.vwbls[i].wndw);
+                    XUnmapWindow(dsp, wins.vwbls[i].fram);
+                    pool_give(dsp, &pool, wins.vwbls[i].fram);
+                    subw = wm_unmanage(&be, &wins, spaces, cur, subw, i, titleh);
+                    filled--;
+                }
+            }
+        }
+        free(gone);
+        tree = &spaces[cur].trees[spaces[cur].outp];
+        layout_outputs(&be, &spaces[cur], &wins, &outs, titleh);
+        x_focus(dsp, subw != -1 ? wins.vwbls[subw].wndw : 0);
+        XFlush(dsp);
+        LOG(LOG_INFO, "Picked up %d windows from the last instance", filled);
+    }
+
+    // the trace starts here, so that the windows taken over below are in it too
+    FILE *rec = NULL;
+    char *recPath = getenv("ARMW_RECORD");
+    if (recPath != NULL && (rec = fopen(recPath, "ae")) == NULL) {
+        LOG(LOG_WARN, "Could not record to %s: %s", recPath, strerror(errno));
+    }
+    if (rec != NULL) {
+        setvbuf(rec, NULL, _IOLBF, 0);
+    }
+
+    // frame whatever was mapped before we got here (say, after another wm quit), all in
+    // one batch. focus follows the newest, so they spiral in like a run of MapRequests would.
+    // in a trace that's a map and a pick each, the pick is what moves the focus along
+    Found *found;
+    int nfound = fetch_existing(dsp, root, &ttls, &wins, &found);
+    for (int f = 0; f < nfound; f++) {
+        int i = wm_manage(&be, &wins, spaces, cur, subw, found[f].wndw, tilingVertically, titleh);
+        Viewable *vwbl = &wins.vwbls[i];
+        set_title(dsp, vwbl, &ttls, found[f].ttl);
+        set_hints(vwbl, found[f].hntd ? &found[f].hints : NULL);
+        vwbl->fram = add_frame_to_window(dsp, &be, root, vwbl, tree->nodes[vwbl->node].area,
+                titleh, pens, &pool);
+        table_index(&wins, vwbl->fram, i);
+        table_mark_title(&wins, i);
+        fetch_property(dsp, vwbl, F_PROTOCOLS);
+        subw = i;
+        filled++;
+        if (rec != NULL) {
+            fprintf(rec, "map %lu\npick %lu\n", vwbl->wndw, vwbl->wndw);
+        }
+    }
+    free(found);
+    if (nfound > 0) {
+        x_focus(dsp, wins.vwbls[subw].wndw);
+        XFlush(dsp);
+    }
+    LOG(LOG_INFO, "Ready after %lluus, took over %d windows", now_us() - start, nfound);
+
+    // kill -USR1 dumps what every event type has cost so far,
+    // and exited children are reaped as soon as SIGCHLD comes in
+    stats.dsp = dsp;
+    stats.root = root;
+    stats.prop = atoms[5];
+    if (fetcher.dsp != NULL) {
+        add_watch(&loop, fetcher.back, fetch_ready, NULL);
+    }
+    int sigfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigfd != -1) {
+        add_watch(&loop, sigfd, handle_signals, NULL);
+    }
     XEvent e;
 
     // main loop, contains event checking and processing
     while (true) {
+        stats_end(dsp); // whatever was handled last time around is done now
         if (XPending(dsp) > 0) {
             XNextEvent(dsp, &e); // get the next event if there is one
-            // attempt to avoid blocking
+            stats_begin(dsp, e.type);
+            if (rec != NULL) {
+                record_event(rec, &e, &keys, &wins, resizing, drag.wndw != None);
+            }
         } else {
-            // title all frames in every Viewable
-            bool didAnything = false;
-            for (int i = 0; i < MAX_WINS; i++) {
-                Viewable vwbl = vwbls[i];
-                if (vwbl.wndw != 0) {
-                    int ascent, descent;
-                    char *title;
-                    title = get_title_of_window(dsp, vwbl.wndw, title, &ascent, &descent, font);
-                    assert(title != NULL);
-                    XGetWindowAttributes(dsp, vwbl.fram,
-                            &attrs);
-                    draw_title_on_frame(dsp, vwbl.fram,
-                            font, title, ascent, descent);
-                    didAnything = true;
+            // answers from the fetch worker, for clients that are still around. reads
+            // that had to wait get another go once these made room, and without a
+            // worker their answers are in done right away
+            Fetch got;
+            bool answered = false;
+            while (fetch_pop(&fetcher.done, &got) || (fetcher.behind && fetch_retry(dsp, &wins)
+                        && fetch_pop(&fetcher.done, &got))) {
+                int i = table_find(&wins, got.wndw);
+                if (i == -1 || wins.vwbls[i].wndw != got.wndw) {
+                    free(got.ttl);
+                    continue;
+                }
+                Viewable *vwbl = &wins.vwbls[i];
+                vwbl->fpnd &= ~(1 << got.kind);
+                if (vwbl->fagn & (1 << got.kind)) {
+                    vwbl->fagn &= ~(1 << got.kind);
+                    fetch_property(dsp, vwbl, got.kind);
+                }
+                answered = true;
+                if (got.kind == F_TITLE && set_title(dsp, vwbl, &ttls, got.ttl)) {
+                    // in a tabbed split the title shows up in the shown tab's bar as well
+                    Tree *t = tree_of(spaces, vwbl);
+                    int tabs = tree_tabs(t, vwbl->node);
+                    if (tabs == -1) {
+                        table_mark_title(&wins, i);
+                    } else {
+                        tree_mark_titles(t, &wins, tabs);
+                    }
+                } else if (got.kind == F_HINTS) {
+                    // the client may not fit its tile the way it wants to any more
+                    set_hints(vwbl, got.ok ? &got.hints : NULL);
+                    Geom fg, wg;
+                    tile_geoms(tree_of(spaces, vwbl)->nodes[vwbl->node].area, titleh, &fg, &wg);
+                    apply_hints(vwbl, &wg.w, &wg.h);
+                    if (wg.w != vwbl->wgeo.w || wg.h != vwbl->wgeo.h) {
+                        move_resize(&be, vwbl->wndw, &vwbl->wgeo, &vwbl->wser,
+                                vwbl->wgeo.x, vwbl->wgeo.y, wg.w, wg.h);
+                    }
+                } else if (got.kind == F_PROTOCOLS) {
+                    bool closing = vwbl->prot & P_CLOSE;
+                    vwbl->prot = got.prot;
+                    if (closing) {
+                        close_client(&pings, vwbl->wndw, vwbl->prot, CurrentTime);
+                    }
                 }
             }
+            if (answered) {
+                XFlush(dsp);
+            }
+
+            // the queue is drained, so render the titles that changed (or whose frames
+            // changed width) once for the whole batch of events we just handled
+            if (wins.ntodo > 0) {
+                for (int i = 0; i < wins.ntodo; i++) {
+                    Viewable *vwbl = &wins.vwbls[wins.todo[i]];
+                    if (vwbl->wndw != 0 && vwbl->tdrw) {
+                        char label[512];
+                        render_title(dsp, vwbl, &ttls, titleh, tab_label(tree_of(spaces, vwbl),
+                                    &wins, wins.todo[i], label, sizeof(label)));
+                        copy_title(dsp, vwbl);
+                        vwbl->tdrw = false;
+                    }
+                }
+                wins.ntodo = 0;
+                XFlush(dsp);
+            }
+
+            // replace the frames the last batch used up, while nobody is waiting on us
+            pool_fill(dsp, root, &pool);
 
-            // semi-sleep for a while if there are no events
-            // this goes on for longer if no windows were actually titled
-            while (XPending(dsp) == 0 && count < (didAnything ? 40 : 80)) {
-                struct timespec tosleep;
-                tosleep.tv_sec = 0;
-                tosleep.tv_nsec = 25000000;
-                struct timespec remsleep;
-                nanosleep(&tosleep, &remsleep);
-                count++;
+#ifdef ARMW_BENCH
+            // let the bench driver see how many requests the last batch cost,
+            // without counting the property updates themselves. the worker's reads
+            // are on its own connection, they count as well
+            unsigned long sent = NextRequest(dsp) - 1 - reqOwn
+                + atomic_load_explicit(&fetcher.sent, memory_order_relaxed);
+            if (sent != reqLast) {
+                reqLast = sent;
+                reqOwn++;
+                XChangeProperty(dsp, root, ARMW_REQS, XA_CARDINAL, 32, PropModeReplace,
+                        (unsigned char *)&sent, 1);
+                XFlush(dsp);
             }
-            count = 0;
+#endif
+
+            // sleep until the server, a timer or a watched fd wakes us up,
+            // but let the log writer catch up with this batch first
+            log_kick();
+            fetch_kick();
+            wait_for_events(&loop, dsp);
             continue;
         }
 
-        //printf("Recv: event, type: %d \n", e.type);
+        // only moves when table_alloc has to grow the table
+        Viewable *vwbls = wins.vwbls;
+
+        //LOG(LOG_DEBUG, "Recv: event, type: %d", e.type);
         if (e.type == MapRequest) {
             // map window with frame and add the ids to an available Viewable
-            puts("Attempting to map window");
-            XGetGeometry(dsp, root, &root,
-                    &dispX, &dispY,
-                    &dispW, &dispH,
-                    &dispBW, &dispZ);
-
-
-            // if there is space in the Viewable list, then we can map the window
-            // otherwise, reject it (possibly will cause a crash but idk)
-            bool foundBlank = false;
-            for (int i = 0; i < MAX_WINS; i++) {
-                if (vwbls[i].wndw == 0) {
-                    foundBlank = true;
-                    break;
-                }
-            }
-            if (!foundBlank) {
-                printf("Cannot map window: %d, destroying!\n", e.xmaprequest.window);
-                XDestroyWindow(dsp, e.xmaprequest.window);
+            LOG(LOG_DEBUG, "Attempting to map window");
 
+            // a window we already manage is just being remapped, nothing to frame
+            if (table_find(&wins, e.xmaprequest.window) != -1) {
+                XMapWindow(dsp, e.xmaprequest.window);
                 continue;
             }
 
-            // get and set attributes needed for random positioning
-            XGetWindowAttributes(dsp, e.xmaprequest.window,
-                    &attrs);
+            // the new window's geometry all comes from splitting the focused tile,
+            // so there is no need to ask the server for the one it asked for
+            LOG(LOG_DEBUG, "There are currently %d windows filled", filled);
 
-            printf("There are currently %d windows filled\n", filled);
-            if (filled == 0) {
-                // fill whole screen if nothing else is there
-                puts("Setting attrs to fullscreen");
-                printf("%dx%d\n", dispW, dispH);
-                attrs.width = dispW;
-                attrs.height = dispH;
-                attrs.x = 0;
-                attrs.y = 0;
-            } else {
-                XWindowAttributes priorAttrs, pwndwAttrs;
-                XGetWindowAttributes(dsp, vwbls[subw].fram, &priorAttrs);
-                XGetWindowAttributes(dsp, vwbls[subw].wndw, &pwndwAttrs);
-                int ascent, descent, direction;
-                XCharStruct overall;
-                XTextExtents(font, "Ag", strlen("Ag"), &direction, &ascent, &descent, &overall);
-
-               if (tilingVertically) {
-                    XMoveResizeWindow(dsp, vwbls[subw].fram,
-                            priorAttrs.x, priorAttrs.y,
-                            priorAttrs.width, priorAttrs.height / 2);
-                    // we get the attributes for the window and the frame
-                    // then we resize the frame to make room for the new Viewable
-
-                    XMoveResizeWindow(dsp, vwbls[subw].wndw,
-                            pwndwAttrs.x, pwndwAttrs.y,
-                            pwndwAttrs.width, (priorAttrs.height / 2) - (ascent + descent));
-                    // and, after calculating the font dims (urggg) we resize the window as well
-
-                    priorAttrs.width += 4;
-                    priorAttrs.height += 4;
-                    // adjusting for 2px borders
-
-                    printf("%dx%d @ %d,%d\n", priorAttrs.width, priorAttrs.height, priorAttrs.x, priorAttrs.y);
-                    attrs.width = priorAttrs.width;
-                    attrs.x = priorAttrs.x;
-                    attrs.y = priorAttrs.y + (priorAttrs.height / 2);
-                    attrs.height = priorAttrs.height / 2;
-                    // we set the new window to take up the space which was left over when we resized the old one
-                    // essentially, we split the old window in two and filled in the new half
-                } else {
-                    // same thing for horizontal, but font stuff isnt needed here
-                    XMoveResizeWindow(dsp, vwbls[subw].fram,
-                            priorAttrs.x, priorAttrs.y,
-                            priorAttrs.width / 2, priorAttrs.height);
-                    XMoveResizeWindow(dsp, vwbls[subw].wndw,
-                            pwndwAttrs.x, pwndwAttrs.y,
-                            (priorAttrs.width / 2), pwndwAttrs.height);
-                    priorAttrs.width += 4;
-                    priorAttrs.height += 4;
-
-                    attrs.width = priorAttrs.width / 2;
-                    attrs.x = priorAttrs.x + (priorAttrs.width / 2);
-                    attrs.y = priorAttrs.y;
-                    attrs.height = priorAttrs.height;
-                }
-            }
+            // split the focused leaf (or the whole screen if nothing is focused)
+            // and lay the affected subtree out again in one go
+            int i = wm_manage(&be, &wins, spaces, cur, subw, e.xmaprequest.window,
+                    tilingVertically, titleh);
+            vwbls = wins.vwbls;
+            Geom area = tree->nodes[vwbls[i].node].area;
+            LOG(LOG_DEBUG, "Requesting %dx%d @ %d,%d", area.w, area.h, area.x, area.y);
 
-            printf("Requesting %dx%d @ %d,%d\n", attrs.width, attrs.height, attrs.x, attrs.y);
             // actually add the frame here (function includes the mapping of both window and frame
-            Window frame = add_frame_to_window(dsp, root, e.xmaprequest.window, attrs, font);
-            if (filled == 0) {
+            // the title, size hints and protocols are read by the worker, until they're
+            // in the title is blank and the client just fills its tile
+            set_title(dsp, &vwbls[i], &ttls, strdup(""));
+            fetch_property(dsp, &vwbls[i], F_TITLE);
+            fetch_property(dsp, &vwbls[i], F_HINTS);
+            fetch_property(dsp, &vwbls[i], F_PROTOCOLS);
+            Window frame = add_frame_to_window(dsp, &be, root, &vwbls[i], area, titleh, pens, &pool);
+            vwbls[i].fram = frame;
+            table_index(&wins, frame, i);
+            table_mark_title(&wins, i);
+            if (subw == -1) {
                 XSetInputFocus(dsp, e.xmaprequest.window, RevertToPointerRoot, CurrentTime);
-                subw = -1;
-            }
-
-            // finally, store the ids in an empty viewable
-            printf("Mapping window: %d/frame: %d\n", e.xmaprequest.window, frame);
-            for (int i = 0; i < MAX_WINS; i++) {
-                if (vwbls[i].wndw == 0) {
-                    vwbls[i].wndw = e.xmaprequest.window;
-                    vwbls[i].fram = frame;
-                    if (subw != -1) {
-                        puts("This isn't the first window, so we can set some properties");
-                        if (tilingVertically) {
-                            vwbls[i].topp = subw;
-                            vwbls[i].left = vwbls[subw].left;
-                            vwbls[i].rite = vwbls[subw].rite;
-                            printf("Set topp on [%d] window to: %d\n", i, vwbls[subw].wndw);
-                            vwbls[subw].botm = i;
-                            printf("Set botm on [%d] window to: %d\n", subw, vwbls[i].wndw);
-                        } else {
-                            vwbls[i].left = subw;
-                            vwbls[i].topp = vwbls[subw].topp;
-                            vwbls[i].botm = vwbls[subw].botm;
-                            vwbls[subw].rite = i;
-                        }
-                    } else {
-                        puts("This is the first window, so we can't set any properties");
-                        subw = i;
-                    }
-                    filled++;
+                subw = i;
+            }
+            LOG(LOG_DEBUG, "Mapping window: %lu/frame: %lu", e.xmaprequest.window, frame);
+            filled++;
+            XFlush(dsp);
+            LOG(LOG_DEBUG, "Finished mapping Viewable");
+        } else if (e.type == Expose) {
+            // repaint the title once the last rectangle of an expose series arrives,
+            // with one copy unless the frame was resized and the title needs rendering again
+            int i = table_find(&wins, e.xexpose.window);
+            if (e.xexpose.count == 0 && i != -1 && vwbls[i].fram == e.xexpose.window) {
+                if (vwbls[i].tpix != None && vwbls[i].tpw == vwbls[i].fgeo.w && !vwbls[i].tdrw) {
+                    copy_title(dsp, &vwbls[i]);
+                } else {
+                    table_mark_title(&wins, i);
+                }
+            }
+#ifdef XRANDR
+        } else if (outs.evb != -1 && e.type == outs.evb + RRScreenChangeNotify) {
+            // monitors came, went or changed mode
+            XRRUpdateConfiguration(&e);
+            outputs_changed(dsp, &be, root, &outs, spaces, cur, &wins, titleh);
+            tree = &spaces[cur].trees[spaces[cur].outp];
+            XFlush(dsp);
+#endif
+        } else if (e.type == ConfigureNotify && e.xconfigure.window == root) {
+            // without randr, the root changing size is all we get to hear
+            if (outs.evb == -1) {
+                outputs_changed(dsp, &be, root, &outs, spaces, cur, &wins, titleh);
+                tree = &spaces[cur].trees[spaces[cur].outp];
+                XFlush(dsp);
+            }
+        } else if (e.type == ConfigureNotify) {
+            // keep our idea of the geometry in sync so nothing ever has to ask the server,
+            // but ignore notifies that predate a configure we already sent
+            int i = table_find(&wins, e.xconfigure.window);
+            if (!e.xconfigure.send_event && i != -1) {
+                Geom *geo = NULL;
+                if (vwbls[i].fram == e.xconfigure.window) {
+                    if (e.xconfigure.serial >= vwbls[i].fser) { geo = &vwbls[i].fgeo; }
+                } else if (e.xconfigure.serial >= vwbls[i].wser) {
+                    geo = &vwbls[i].wgeo;
+                }
+                if (geo != NULL) {
+                    geo->x = e.xconfigure.x;
+                    geo->y = e.xconfigure.y;
+                    geo->w = e.xconfigure.width;
+                    geo->h = e.xconfigure.height;
+                }
+            }
+        } else if (e.type == ConfigureRequest) {
+            // a client wants to move or resize, a burst of these for one window
+            // gets collapsed so that we only configure once. only the ones right behind
+            // this one, a request made after a MapRequest has to wait for the frame
+            XConfigureRequestEvent req = e.xconfigurerequest;
+            XEvent more;
+            while (XPending(dsp) > 0) {
+                XPeekEvent(dsp, &more);
+                if (!same_configure_request(&more, req.window)) {
                     break;
                 }
+                XNextEvent(dsp, &more);
+                merge_configure_request(&req, &more.xconfigurerequest);
+            }
+
+            int i = table_find(&wins, req.window);
+            if (i == -1 || vwbls[i].wndw != req.window) {
+                // not framed (yet), so it can have whatever it asked for
+                XWindowChanges wc;
+                wc.x = req.x;
+                wc.y = req.y;
+                wc.width = req.width;
+                wc.height = req.height;
+                wc.border_width = req.border_width;
+                wc.sibling = req.above;
+                wc.stack_mode = req.detail;
+                XConfigureWindow(dsp, req.window, req.value_mask, &wc);
+            } else {
+                // it stays where it is in its frame, and only gets a size that fits the tile
+                Geom tfg, twg;
+                tile_geoms(tree_of(spaces, &vwbls[i])->nodes[vwbls[i].node].area, titleh, &tfg, &twg);
+                int w = req.value_mask & CWWidth ? req.width : vwbls[i].wgeo.w;
+                int h = req.value_mask & CWHeight ? req.height : vwbls[i].wgeo.h;
+                if (w > twg.w) { w = twg.w; }
+                if (h > twg.h) { h = twg.h; }
+                apply_hints(&vwbls[i], &w, &h);
+                if (w != vwbls[i].wgeo.w || h != vwbls[i].wgeo.h) {
+                    move_resize(&be, vwbls[i].wndw, &vwbls[i].wgeo, &vwbls[i].wser,
+                            vwbls[i].wgeo.x, vwbls[i].wgeo.y, w, h);
+                }
+                send_configure_notify(dsp, &vwbls[i]);
             }
-            puts("Finished mapping Viewable");
-        } else if (e.type == Expose) {
         } else if (e.type == PropertyNotify) {
+            // only title and size hint changes invalidate the cache, other properties are ignored
+            int i = table_find(&wins, e.xproperty.window);
+            if (i == -1 || vwbls[i].wndw != e.xproperty.window) {
+                // not one of our clients
+            } else if (e.xproperty.atom == XA_WM_NAME || e.xproperty.atom == WM_NAME) {
+                fetch_property(dsp, &vwbls[i], F_TITLE);
+            } else if (e.xproperty.atom == XA_WM_NORMAL_HINTS) {
+                fetch_property(dsp, &vwbls[i], F_HINTS);
+            } else if (e.xproperty.atom == WM_PROTOCOLS) {
+                fetch_property(dsp, &vwbls[i], F_PROTOCOLS);
+            }
         } else if (e.type == DestroyNotify) {
-            puts("Destroying a window");
-            // destroy empty frames and remove window from list
-            for (int i = 0; i < MAX_WINS; i++) {
-                if (vwbls[i].wndw == e.xdestroywindow.window) {
-                    // find the appropriate Viewable, unparent the window from the frame,
-                    // kill the frame, and reset the Viewable
-                    Window focused = vwbls[subw].wndw;
-                    int toFocus;
-                    printf("Focused: %d vs ToDelete: %d\n", focused, vwbls[i].wndw);
-                    if (focused == vwbls[i].wndw) {
-                        puts("Refocusing, dont want to delete focused window");
-                        if (vwbls[i].topp != -1) {
-                            toFocus = vwbls[i].topp;
-                            puts("Focusing on top");
-                        } else if (vwbls[i].botm != -1) {
-                            toFocus = vwbls[i].botm;
-                            puts("Focusing on bottom");
-                        } else if (vwbls[i].left != -1) {
-                            toFocus = vwbls[i].left;
-                            puts("Focusing on left");
-                        } else if (vwbls[i].rite != -1) {
-                            toFocus = vwbls[i].rite;
-                            puts("Focusing on right");
-                        } else {
-                            puts("Focusing on root");
-                            toFocus = root;
-                        }
-                        if (toFocus != root) {
-                            printf("Refocusing on window: %d\n", vwbls[toFocus].wndw);
-                            XSetInputFocus(dsp, vwbls[toFocus].wndw, RevertToPointerRoot, CurrentTime);
-                            subw = toFocus;
-                        } else {
-                            XSetInputFocus(dsp, toFocus, RevertToPointerRoot, CurrentTime);
-                            subw = -1;
-                        }
-                    }
+            LOG(LOG_DEBUG, "Destroying a window");
+            // recycle empty frames and remove window from list
+            int i = table_find(&wins, e.xdestroywindow.window);
+            if (i != -1 && vwbls[i].wndw == e.xdestroywindow.window) {
+                // the client is gone, so just hide the frame and keep it for the next one
+                LOG(LOG_DEBUG, "Destroyed window: %lu -> frame: %lu", vwbls[i].wndw,
+                        vwbls[i].fram);
+                XUnmapWindow(dsp, vwbls[i].fram);
+                pool_give(dsp, &pool, vwbls[i].fram);
+                free_title(dsp, &vwbls[i]);
+                // its id may be handed out again, so a pending ping mustn't kill whoever gets it
+                ping_answered(&pings, vwbls[i].wndw);
 
-                    printf("Destroyed window: %d -> frame: %d\n", vwbls[i].wndw,
-                            vwbls[i].fram);
-                    XUnmapWindow(dsp, vwbls[i].fram);
-                    XReparentWindow(dsp, vwbls[i].wndw, root, 0, 0);
-                    XDestroyWindow(dsp, vwbls[i].fram);
-                    vwbls[i].wndw = 0;
-                    vwbls[i].fram = 0;
-                    if (vwbls[i].botm != -1 && vwbls[vwbls[i].botm].topp == i) {
-                        vwbls[vwbls[i].botm].topp = vwbls[i].topp;
-                    }
-                    if (vwbls[i].topp != -1 && vwbls[vwbls[i].topp].botm == i) {
-                        vwbls[vwbls[i].topp].botm = vwbls[i].botm;
-                    }
-                    if (vwbls[i].left != -1 && vwbls[vwbls[i].left].rite == i) {
-                        vwbls[vwbls[i].left].rite = vwbls[i].rite;
-                    }
-                    if (vwbls[i].rite != -1 && vwbls[vwbls[i].rite].left == i) {
-                        vwbls[vwbls[i].rite].left = vwbls[i].left;
-                    }
-                    vwbls[i].botm = -1;
-                    vwbls[i].topp = -1;
-                    vwbls[i].left = -1;
-                    vwbls[i].rite = -1;
-                    filled--;
-                    printf("There are now %d windows\n", filled);
-                    break;
-                }
+                // give the space back to the sibling, and move focus there if we had it
+                // (a window on a hidden workspace only changes what that one will focus)
+                subw = wm_unmanage(&be, &wins, spaces, cur, subw, i, titleh);
+                filled--;
+                LOG(LOG_DEBUG, "There are now %d windows", filled);
+                XFlush(dsp);
             }
+        } else if (e.type == ClientMessage && e.xclient.message_type == WM_PROTOCOLS
+                && (Atom)e.xclient.data.l[0] == NET_WM_PING) {
+            // a pong: the client is alive, so it gets to close (or not) in its own time
+            ping_answered(&pings, e.xclient.data.l[2]);
         } else if (e.type == EnterNotify) {
             /*
             // change focus based on location of mouse
-            for (int i = 0; i < MAX_WINS; i++) {
-                if (vwbls[i].wndw == e.xcrossing.subwindow ||
-                        vwbls[i].fram == e.xcrossing.window) {
-                    // match the event subwindow with a Viewable and save the Viewable's
-                    // frame and window info
-                    e.xcrossing.subwindow = vwbls[i].wndw;
-                    subw = i;
-                    break;
-                }
+            int i = table_find(&wins, e.xcrossing.window);
+            if (i != -1) {
+                // match the event window with a Viewable and save the Viewable's
+                // frame and window info
+                e.xcrossing.subwindow = vwbls[i].wndw;
+                subw = i;
             }
 
-            printf("Entered window: %d\n", vwbls[subw].wndw);
+            LOG(LOG_DEBUG, "Entered window: %lu", vwbls[subw].wndw);
             XGetWindowAttributes(dsp, vwbls[subw].wndw,
                     &attrs);
             // explicitly change focus to the desired window
             XSetInputFocus(dsp, vwbls[subw].wndw, RevertToPointerRoot, CurrentTime);
-            printf("%dx%d @ %d,%d\n",
+            LOG(LOG_DEBUG, "%dx%d @ %d,%d",
                     attrs.width, attrs.height, attrs.x, attrs.y);
                     */
-        } else if (e.type == KeyPress && e.xkey.keycode == K_e) {
-            // kill the wm with a cheerful message
-            puts("Gonna go die now, seeya!");
+        } else if (e.type == MappingNotify) {
+            // keycodes or modifiers moved around, so the grabs have to be redone
+            XRefreshKeyboardMapping(&e.xmapping);
+            if (e.xmapping.request == MappingKeyboard || e.xmapping.request == MappingModifier) {
+                grab_bindings(dsp, root, &keys);
+            }
+        } else if (e.type == KeyPress && find_binding(&keys, &e.xkey) == NULL) {
+            // not one of ours (a grab from before a mapping change)
+        } else if (e.type == KeyPress && find_binding(&keys, &e.xkey)->act == A_QUIT) {
+            // kill the wm with a cheerful message, leaving the clients to whoever comes next
+            release_clients(dsp, root, &wins);
+            LOG(LOG_INFO, "Gonna go die now, seeya!");
+            log_drain();
             exit(0);
         } else if (e.type == KeyPress) {
-            puts("Handling keypresses...");
-            // handle various keyboard actions
-            if (subw != -1) {
-                XGetWindowAttributes(dsp, vwbls[subw].wndw, &attrs);
-            }
+            LOG(LOG_DEBUG, "Handling keypresses...");
+            // handle various keyboard actions, the bindings table says which one
+            const Binding *bind = find_binding(&keys, &e.xkey);
 
-            // set the movement scale based on how long its been since the last keyboard event
-            // may change this in the future for consistency
-            if (time(NULL) - ltime < 2) { kcnt++; }
-            else { kcnt = 2; }
-            ltime = time(NULL);
+            // set the movement scale based on how long its been since the last keyboard event,
+            // keys held down (or tapped quickly) keep speeding up
+            if (now_ms() - ltime < KEY_ACCEL_MS) {
+                if (kcnt < KEY_MAX_STEP) { kcnt++; }
+            } else {
+                kcnt = 2;
+            }
+            ltime = now_ms();
 
-            // get attributes about the current focused window
-            Window wndw;
-            Window fram;
-            XWindowAttributes wndwAttrs;
-            XWindowAttributes framAttrs;
+            // the focused window and frame, with the geometry we keep for them
+            Window wndw = None;
+            Window fram = None;
+            Viewable *vwbl = NULL;
 
             if (subw != -1) {
-                wndw = vwbls[subw].wndw;
-                fram = vwbls[subw].fram;
-                printf("Got keypress from window: %d/frame: %d\n", wndw, fram);
-                XGetWindowAttributes(dsp, wndw, &wndwAttrs);
-                XGetWindowAttributes(dsp, fram, &framAttrs);
+                vwbl = &vwbls[subw];
+                wndw = vwbl->wndw;
+                fram = vwbl->fram;
+                LOG(LOG_DEBUG, "Got keypress from window: %lu/frame: %lu", wndw, fram);
             } else {
-                puts("Got keypress from root");
+                LOG(LOG_DEBUG, "Got keypress from root");
             }
 
-            printf("%d\n", e.xkey.state);
+            LOG(LOG_DEBUG, "Key state: %u", e.xkey.state);
 
             // long if-else chain to act on the window
-            int Kp = e.xkey.keycode;
-            if (Kp == K_opabe) {
+            int act = bind->act;
+            int dir = bind->arg;
+            bool directional = act == A_FOCUS || act == A_MOVE;
+            if (vwbl == NULL && act != A_RESIZING && act != A_SPAWN && act != A_TILE
+                    && act != A_VIEW && act != A_OUTPUT && act != A_RESTART) {
+                // nothing focused, nothing to move
+            } else if (act == A_RAISE) {
                 // put window on top if so desired
-                XRaiseWindow(dsp, vwbls[subw].fram);
-            } else if (Kp == K_h) {
-                // handle left actions (resizing and movement)
-                if (resizing) {
-                    if (wndwAttrs.width > kcnt) {
-                        XMoveResizeWindow(dsp, wndw,
-                                wndwAttrs.x, wndwAttrs.y,
-                                wndwAttrs.width - kcnt, wndwAttrs.height);
-                        XMoveResizeWindow(dsp, fram,
-                                framAttrs.x, framAttrs.y,
-                                framAttrs.width - kcnt, framAttrs.height);
-                    }
-                } else {
-                    if (e.xkey.state == 9) {
-                        XMoveResizeWindow(dsp, vwbls[subw].fram,
-                                framAttrs.x - kcnt, framAttrs.y,
-                                framAttrs.width, framAttrs.height);
-                    } else if (e.xkey.state == 8 && vwbls[subw].left != -1) {
-                        XSetInputFocus(dsp, vwbls[vwbls[subw].left].wndw, RevertToPointerRoot, CurrentTime);
-                        subw = vwbls[subw].left;
-                    }
-                }
-            } else if (Kp == K_j) {
-                // handle down actions
-                if (resizing) {
-                    XMoveResizeWindow(dsp, wndw,
-                            wndwAttrs.x, wndwAttrs.y,
-                            wndwAttrs.width, wndwAttrs.height + kcnt);
-                    XMoveResizeWindow(dsp, fram,
-                            framAttrs.x, framAttrs.y,
-                            framAttrs.width, framAttrs.height + kcnt);
-                } else {
-                    if (e.xkey.state == 9) {
-                        XMoveResizeWindow(dsp, vwbls[subw].fram,
-                                framAttrs.x, framAttrs.y + kcnt,
-                                framAttrs.width, framAttrs.height);
-                    } else if (e.xkey.state == 8 && vwbls[subw].botm != -1) {
-                        XSetInputFocus(dsp, vwbls[vwbls[subw].botm].wndw, RevertToPointerRoot, CurrentTime);
-                        printf("Focus changed to window: %d\n", vwbls[vwbls[subw].botm].wndw);
-                        subw = vwbls[subw].botm;
-                    }
-                }
-            } else if (Kp == K_k) {
-                // handle up actions
-                if (resizing) {
-                    if (wndwAttrs.height > kcnt) {
-                        XMoveResizeWindow(dsp, wndw,
-                                wndwAttrs.x, wndwAttrs.y,
-                                wndwAttrs.width, wndwAttrs.height - kcnt);
-                        XMoveResizeWindow(dsp, fram,
-                                framAttrs.x, framAttrs.y,
-                                framAttrs.width, framAttrs.height - kcnt);
-                    }
-                } else {
-                    if (e.xkey.state == 9) {
-                        XMoveResizeWindow(dsp, vwbls[subw].fram,
-                                framAttrs.x, framAttrs.y - kcnt,
-                                framAttrs.width, framAttrs.height);
-                    } else if (e.xkey.state == 8 && vwbls[subw].topp != -1) {
-                        XSetInputFocus(dsp, vwbls[vwbls[subw].topp].wndw, RevertToPointerRoot, CurrentTime);
-                        printf("Focus changed to window: %d\n", vwbls[vwbls[subw].topp].wndw);
-                        subw = vwbls[subw].topp;
-                    }
-                }
-            } else if (Kp == K_l) {
-                // handle right actions
-                if (resizing) {
-                    XMoveResizeWindow(dsp, wndw,
-                            wndwAttrs.x, wndwAttrs.y,
-                            wndwAttrs.width + kcnt, wndwAttrs.height);
-                    XMoveResizeWindow(dsp, fram,
-                            framAttrs.x, framAttrs.y,
-                            framAttrs.width + kcnt, framAttrs.height);
-                } else {
-                    if (e.xkey.state == 9) {
-                        XMoveResizeWindow(dsp, vwbls[subw].fram,
-                                framAttrs.x + kcnt, framAttrs.y,
-                                framAttrs.width, framAttrs.height);
-                    } else if (e.xkey.state == 8 && vwbls[subw].rite != -1) {
-                        XSetInputFocus(dsp, vwbls[vwbls[subw].rite].wndw, RevertToPointerRoot, CurrentTime);
-                        subw = vwbls[subw].rite;
-                    }
+                XRaiseWindow(dsp, fram);
+            } else if (directional && resizing) {
+                // grow or shrink both the window and its frame, once for all queued repeats
+                int step = fold_repeats(dsp, &e.xkey, &kcnt);
+                Geom wg = vwbl->wgeo;
+                Geom fg = vwbl->fgeo;
+                int dw = dir == DIR_LEFT ? -step : dir == DIR_RIGHT ? step : 0;
+                int dh = dir == DIR_UP ? -step : dir == DIR_DOWN ? step : 0;
+                if (wg.w + dw > 0 && wg.h + dh > 0) {
+                    move_resize(&be, wndw, &vwbl->wgeo, &vwbl->wser,
+                            wg.x, wg.y, wg.w + dw, wg.h + dh);
+                    move_resize(&be, fram, &vwbl->fgeo, &vwbl->fser,
+                            fg.x, fg.y, fg.w + dw, fg.h + dh);
                 }
-            } else if (Kp == K_r) {
+            } else if (act == A_MOVE) {
+                // move the frame around, once for all queued repeats
+                int step = fold_repeats(dsp, &e.xkey, &kcnt);
+                Geom fg = vwbl->fgeo;
+                int dx = dir == DIR_LEFT ? -step : dir == DIR_RIGHT ? step : 0;
+                int dy = dir == DIR_UP ? -step : dir == DIR_DOWN ? step : 0;
+                move_resize(&be, fram, &vwbl->fgeo, &vwbl->fser,
+                        fg.x + dx, fg.y + dy, fg.w, fg.h);
+            } else if (act == A_FOCUS) {
+                // switch focus to the neighbour in that direction, if there is one
+                subw = wm_focus(&be, tree, &wins, subw, dir);
+            } else if (act == A_RESIZING) {
                 // toggle resize mode
                 resizing = !resizing;
-            } else if (Kp == K_d) {
-                // start dmenu
-                start_external("dmenu_run");
-            } else if (Kp == K_b) {
-                tilingVertically = false;
-            } else if (Kp == K_v) {
-                tilingVertically = true;
-            } else if (Kp == K_q) {
-                // kill the window in the best way possible
-
-                Atom *supported;
-                int num_supported;
-
-                // get the available window protocols and see if it supports
-                // elegant killing
-                XGetWMProtocols(dsp, wndw, &supported, &num_supported);
-                bool found = false;
-                for (int i = 0; i < num_supported; i++) {
-                    if (supported[i] == WM_DELETE_WINDOW) {
-                        printf("%d\n", supported[i]);
-                        found = true;
-                        puts("WM_DELETE_WINDOW present!");
-                        break;
+            } else if (act == A_SPAWN) {
+                // start dmenu (or whatever else is bound)
+                start_external((char *)bind->cmd);
+            } else if (act == A_TILE) {
+                tilingVertically = bind->arg;
+            } else if (act == A_VIEW && bind->arg != cur) {
+                // swap the visible set of windows for another workspace's. everything goes out
+                // as one batch under a server grab, so nothing repaints halfway through and
+                // there isn't a single round trip
+                XGrabServer(dsp);
+                subw = wm_view(&be, &wins, spaces, &outs, &cur, subw, bind->arg, titleh);
+                tree = &spaces[cur].trees[spaces[cur].outp];
+                XUngrabServer(dsp);
+                XFlush(dsp);
+                LOG(LOG_DEBUG, "Switched to workspace %d", cur + 1);
+            } else if (act == A_SEND && bind->arg != cur) {
+                // move the focused window over to another workspace
+                subw = wm_send(&be, &wins, spaces, cur, subw, bind->arg, tilingVertically, titleh);
+            } else if (act == A_TABBED) {
+                // turn the split the focused window is in into tabs (or back)
+                wm_tabbed(&be, tree, &wins, subw, titleh);
+                XFlush(dsp);
+            } else if (act == A_TAB) {
+                // flip the nearest tabbed split over to its other tab and focus that
+                subw = wm_tab(&be, tree, &wins, subw);
+                XFlush(dsp);
+            } else if (act == A_OUTPUT && outs.n > 1) {
+                // move the focus to the next (or previous) output, new windows go there too
+                subw = wm_output(&be, &wins, spaces, &outs, cur, bind->arg);
+                tree = &spaces[cur].trees[spaces[cur].outp];
+            } else if (act == A_RESTART) {
+                // hand over to a fresh copy of the binary (possibly a newer one) without
+                // touching a single window: the frames outlive our connection, and the state
+                // goes into a memfd that survives the exec
+                int fd = memfd_create("armw-state", 0);
+                FILE *f = fd != -1 ? fdopen(dup(fd), "w") : NULL;
+                if (f == NULL) {
+                    LOG(LOG_WARN, "Could not save the state for a restart: %s", strerror(errno));
+                    if (fd != -1) { close(fd); }
+                    continue;
+                }
+                save_state(f, &wins, spaces, cur, subw);
+                fclose(f);
+                lseek(fd, 0, SEEK_SET);
+                char num[16];
+                snprintf(num, sizeof(num), "%d", fd);
+                setenv("ARMW_STATE", num, 1);
+
+                // the spare frames and title pixmaps would only leak, everything else stays
+                for (int n = 0; n < pool.n; n++) {
+                    XDestroyWindow(dsp, pool.frms[n]);
+                }
+                pool.n = 0;
+                for (int n = 0; n < wins.used; n++) {
+                    if (vwbls[n].wndw != 0) {
+                        free_title(dsp, &vwbls[n]);
+                        table_mark_title(&wins, n);
                     }
                 }
-                if (found) {
-                    // elegantly kill a window with support
-                    printf("Sending killMsg to window: %d\n", wndw);
-                    XEvent killMsg;
-                    killMsg.xclient.type = ClientMessage;
-                    killMsg.xclient.message_type = WM_PROTOCOLS;
-                    killMsg.xclient.window = wndw;
-                    killMsg.xclient.format = 32;
-                    killMsg.xclient.data.l[0] = WM_DELETE_WINDOW;
-                    XSendEvent(dsp, wndw, false, 0, &killMsg);
+                // temporary, so that release_clients in the next instance can clean it all up
+                XSetCloseDownMode(dsp, RetainTemporary);
+                RT(RT_SYNC, XSync(dsp, false));
+                LOG(LOG_INFO, "Restarting as %s", argv[0]);
+                log_drain();
+                execvp(argv[0], argv);
+
+                // still here, so just carry on
+                LOG(LOG_WARN, "Could not restart: %s", strerror(errno));
+                XSetCloseDownMode(dsp, DestroyAll);
+                unsetenv("ARMW_STATE");
+                close(fd);
+            } else if (act == A_CLOSE) {
+                // close the window with what WM_PROTOCOLS says, as cached at map time.
+                // if that read hasn't come back yet, its answer does the closing
+                if (vwbl->prot & P_KNOWN) {
+                    close_client(&pings, wndw, vwbl->prot, e.xkey.time);
                 } else {
-                    // just kill the client with more simple windows
-                    printf("Killing window: %d\n", wndw);
-                    XKillClient(dsp, wndw);
-                    printf("Killing frame: %d\n", fram);
-                    XKillClient(dsp, fram);
+                    vwbl->prot |= P_CLOSE;
                 }
             }
 
-        } else if (e.type == ButtonPress &&
-                e.xbutton.subwindow != None) {
-            // optional focus on alt+leftclick
-            XGetWindowAttributes(dsp, e.xbutton.subwindow,
-                    &attrs);
-            vwbls[subw].wndw = e.xbutton.subwindow;
-            vwbls[subw].fram = e.xbutton.window;
-            printf("%dx%d @ %d,%d\n",
-                    attrs.width, attrs.height, attrs.x, attrs.y);
+        } else if (e.type == ButtonPress) {
+            // mod+click focuses and raises a client, dragging on from there moves it
+            // (left button) or resizes it (right button)
+            int i = table_find(&wins, e.xbutton.subwindow);
+            if (drag.wndw != None || i == -1 || vwbls[i].fram != e.xbutton.subwindow) {
+                continue;
+            }
+            if (i != subw) {
+                subw = wm_pick(&be, &wins, spaces, cur, i);
+                tree = &spaces[cur].trees[spaces[cur].outp];
+            }
+            XRaiseWindow(dsp, vwbls[i].fram);
+            drag.wndw = vwbls[i].wndw;
+            drag.button = e.xbutton.button;
+            drag.x0 = drag.x = e.xbutton.x_root;
+            drag.y0 = drag.y = e.xbutton.y_root;
+            drag.fg0 = vwbls[i].fgeo;
+            drag.wg0 = vwbls[i].wgeo;
+            drag.dirty = false;
+            drag.last = 0;
+            XFlush(dsp);
+        } else if (e.type == MotionNotify) {
+            // only the latest position matters, so the motions queued right behind this one
+            // replace it. anything else in between keeps its order, a release included
+            while (XPending(dsp) > 0) {
+                XEvent next;
+                XPeekEvent(dsp, &next);
+                if (next.type != MotionNotify) {
+                    break;
+                }
+                XNextEvent(dsp, &e);
+            }
+            if (drag.wndw != None) {
+                drag_motion(&drag, e.xmotion.x_root, e.xmotion.y_root);
+            }
+        } else if (e.type == ButtonRelease) {
+            if (drag.wndw != None && e.xbutton.button == drag.button) {
+                drag_end(&drag, e.xbutton.x_root, e.xbutton.y_root);
+            }
         }
     }
     return 0;
@@ -0,0 +1,230 @@
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+
+// synthetic client driver for benchmarking Armw, see the bench target in the Makefile
+// maps and destroys windows and drives the Mod1 bindings through XTest, timing how long
+// it takes from our request until the wm's reaction shows up as an event
+
+#define TIMEOUT_MS 2000
+
+// latencies (in microseconds) and wm requests for one kind of operation
+typedef struct Samples Samples;
+struct Samples {
+    const char *name;
+    double *lat;
+    int n;
+    unsigned long reqs;
+};
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// what wait_for is looking for
+typedef struct Want Want;
+struct Want {
+    int type;
+    Window w;
+};
+
+Bool matches(Display *dsp, XEvent *e, XPointer arg) {
+    Want *want = (Want *)arg;
+    return e->type == want->type && (want->w == None || e->xany.window == want->w);
+}
+
+// waits for an event matching type and window (None matches any window), leaving
+// everything else queued. returns false if it didn't show up in time
+bool wait_for(Display *dsp, int type, Window w, XEvent *out) {
+    double deadline = now_us() + TIMEOUT_MS * 1000.0;
+    Want want = { type, w };
+    while (true) {
+        XEvent e;
+        XPending(dsp);
+        if (XCheckIfEvent(dsp, &e, matches, (XPointer)&want)) {
+            if (out != NULL) { *out = e; }
+            return true;
+        }
+        int left = (deadline - now_us()) / 1000;
+        if (left <= 0) {
+            return false;
+        }
+        struct pollfd pfd = { ConnectionNumber(dsp), POLLIN, 0 };
+        poll(&pfd, 1, left);
+    }
+}
+
+// how many requests the wm has sent so far, as published in _ARMW_REQUESTS
+unsigned long wm_requests(Display *dsp, Window root, Atom prop) {
+    Atom type;
+    int format;
+    unsigned long n, after;
+    unsigned char *data = NULL;
+    unsigned long reqs = 0;
+    if (XGetWindowProperty(dsp, root, prop, 0, 1, false, XA_CARDINAL,
+                &type, &format, &n, &after, &data) == Success && data != NULL) {
+        if (n == 1) { reqs = *(unsigned long *)data; }
+        XFree(data);
+    }
+    return reqs;
+}
+
+// the wm publishes its request count once its queue runs dry, so wait for that
+// (or give up quickly if nothing changed) before reading it
+unsigned long settled_requests(Display *dsp, Window root, Atom prop) {
+    XEvent e;
+    double deadline = now_us() + 100000;
+    while (now_us() < deadline) {
+        if (XCheckTypedWindowEvent(dsp, root, PropertyNotify, &e)) {
+            if (e.xproperty.atom == prop) { break; }
+            continue;
+        }
+        struct pollfd pfd = { ConnectionNumber(dsp), POLLIN, 0 };
+        poll(&pfd, 1, 5);
+        XPending(dsp);
+    }
+    return wm_requests(dsp, root, prop);
+}
+
+void record(Samples *s, double t0, unsigned long reqs) {
+    s->lat[s->n++] = now_us() - t0;
+    s->reqs += reqs;
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+void report(Samples *s) {
+    if (s->n == 0) {
+        printf("%-8s  no samples\n", s->name);
+        return;
+    }
+    qsort(s->lat, s->n, sizeof(double), cmp_double);
+    printf("%-8s  n=%-5d p50=%8.1fus  p99=%8.1fus  reqs/op=%.1f\n", s->name, s->n,
+            s->lat[s->n / 2], s->lat[(s->n * 99) / 100], (double)s->reqs / s->n);
+}
+
+// presses mod1 (plus shift if asked) and a key, then lets go of everything
+void send_binding(Display *dsp, KeySym sym, bool shift) {
+    KeyCode alt = XKeysymToKeycode(dsp, XK_Alt_L);
+    KeyCode shf = XKeysymToKeycode(dsp, XK_Shift_L);
+    KeyCode key = XKeysymToKeycode(dsp, sym);
+    XTestFakeKeyEvent(dsp, alt, true, CurrentTime);
+    if (shift) { XTestFakeKeyEvent(dsp, shf, true, CurrentTime); }
+    XTestFakeKeyEvent(dsp, key, true, CurrentTime);
+    XTestFakeKeyEvent(dsp, key, false, CurrentTime);
+    if (shift) { XTestFakeKeyEvent(dsp, shf, false, CurrentTime); }
+    XTestFakeKeyEvent(dsp, alt, false, CurrentTime);
+    XFlush(dsp);
+}
+
+// the frame the wm put a window in, we watch it to see moves and destroys
+Window frame_of(Display *dsp, Window w) {
+    Window root, prnt, *kids;
+    unsigned int n;
+    if (!XQueryTree(dsp, w, &root, &prnt, &kids, &n)) {
+        return None;
+    }
+    if (kids != NULL) { XFree(kids); }
+    return prnt;
+}
+
+int main(int argc, char **argv) {
+    int nwins = argc > 1 ? atoi(argv[1]) : 50;
+    if (nwins < 2) { nwins = 2; }
+
+    Display *dsp = XOpenDisplay(0);
+    if (dsp == NULL) {
+        fputs("armw-bench: cannot open display\n", stderr);
+        return 1;
+    }
+    int evb, erb, maj, min;
+    if (!XTestQueryExtension(dsp, &evb, &erb, &maj, &min)) {
+        fputs("armw-bench: the server has no XTest\n", stderr);
+        return 1;
+    }
+    Window root = DefaultRootWindow(dsp);
+    Atom REQS = XInternAtom(dsp, "_ARMW_REQUESTS", false);
+    XSelectInput(dsp, root, PropertyChangeMask);
+
+    Window *wins = calloc(nwins, sizeof(Window));
+    Window *frms = calloc(nwins, sizeof(Window));
+    Samples map = { "map", calloc(nwins, sizeof(double)), 0, 0 };
+    Samples focus = { "focus", calloc(nwins * 2, sizeof(double)), 0, 0 };
+    Samples move = { "move", calloc(nwins * 2, sizeof(double)), 0, 0 };
+    Samples dstr = { "destroy", calloc(nwins, sizeof(double)), 0, 0 };
+
+    // map: until the client itself is mapped inside its frame
+    for (int i = 0; i < nwins; i++) {
+        XSync(dsp, true);
+        unsigned long r0 = wm_requests(dsp, root, REQS);
+        wins[i] = XCreateSimpleWindow(dsp, root, 0, 0, 200, 100, 0, 0, 0xffffff);
+        XSelectInput(dsp, wins[i], StructureNotifyMask | FocusChangeMask);
+        double t0 = now_us();
+        XMapWindow(dsp, wins[i]);
+        XFlush(dsp);
+        if (!wait_for(dsp, MapNotify, wins[i], NULL)) {
+            fprintf(stderr, "armw-bench: window %d was never mapped, is Armw running?\n", i);
+            return 1;
+        }
+        record(&map, t0, settled_requests(dsp, root, REQS) - r0);
+        frms[i] = frame_of(dsp, wins[i]);
+        XSelectInput(dsp, frms[i], StructureNotifyMask);
+    }
+
+    // focus: bounce between neighbours with mod+l/h until one of our windows gets FocusIn
+    for (int i = 0; i < nwins * 2; i++) {
+        XSync(dsp, true);
+        unsigned long r0 = wm_requests(dsp, root, REQS);
+        double t0 = now_us();
+        send_binding(dsp, i % 2 ? XK_h : XK_l, false);
+        XEvent e;
+        if (wait_for(dsp, FocusIn, None, &e)) {
+            record(&focus, t0, settled_requests(dsp, root, REQS) - r0);
+        }
+    }
+
+    // move: mod+shift+h/l on whatever is focused, until its frame gets configured
+    for (int i = 0; i < nwins * 2; i++) {
+        XSync(dsp, true);
+        unsigned long r0 = wm_requests(dsp, root, REQS);
+        double t0 = now_us();
+        send_binding(dsp, i % 2 ? XK_h : XK_l, true);
+        XEvent e;
+        if (wait_for(dsp, ConfigureNotify, None, &e)) {
+            record(&move, t0, settled_requests(dsp, root, REQS) - r0);
+        }
+    }
+
+    // destroy: until the wm has taken the frame down as well (it gets pooled, not destroyed)
+    for (int i = nwins - 1; i >= 0; i--) {
+        XSync(dsp, true);
+        unsigned long r0 = wm_requests(dsp, root, REQS);
+        double t0 = now_us();
+        XDestroyWindow(dsp, wins[i]);
+        XFlush(dsp);
+        if (wait_for(dsp, UnmapNotify, frms[i], NULL)) {
+            record(&dstr, t0, settled_requests(dsp, root, REQS) - r0);
+        }
+    }
+
+    printf("armw-bench: %d windows\n", nwins);
+    report(&map);
+    report(&focus);
+    report(&move);
+    report(&dstr);
+    XCloseDisplay(dsp);
+    return 0;
+}
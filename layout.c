@@ -0,0 +1,773 @@
+#include <stdlib.h>
+#include <string.h>
+#include "layout.h"
+
+#define HASH_EMPTY ((Xid)0)
+#define HASH_TOMB  ((Xid)-1)
+
+// fibonacci hashing, X ids are mostly sequential so the low bits alone would cluster
+unsigned int hash_window(Xid w, int hcap) {
+    return (unsigned int)((w * 11400714819323198485ull) >> 32) & (hcap - 1);
+}
+
+void table_init(Table *t) {
+    memset(t, 0, sizeof(*t));
+    t->cap = INIT_WINS;
+    t->vwbls = calloc(t->cap, sizeof(Viewable));
+    t->frees = malloc(t->cap * sizeof(int));
+    t->tcap = INIT_WINS;
+    t->todo = malloc(t->tcap * sizeof(int));
+    t->hcap = INIT_WINS * 4;
+    t->keys = calloc(t->hcap, sizeof(Xid));
+    t->vals = malloc(t->hcap * sizeof(int));
+}
+
+// returns the slot a client or frame lives in, or -1 if we don't manage it
+int table_find(Table *t, Xid w) {
+    if (w == HASH_EMPTY || w == HASH_TOMB) {
+        return -1;
+    }
+    for (unsigned int i = hash_window(w, t->hcap);; i = (i + 1) & (t->hcap - 1)) {
+        if (t->keys[i] == w) {
+            return t->vals[i];
+        } else if (t->keys[i] == HASH_EMPTY) {
+            return -1;
+        }
+    }
+}
+
+// rebuilds the hash with room to spare, dropping tombstones along the way
+void table_rehash(Table *t) {
+    Xid *keys = t->keys;
+    int *vals = t->vals;
+    int hcap = t->hcap;
+
+    int live = 0;
+    for (int i = 0; i < hcap; i++) {
+        if (keys[i] != HASH_EMPTY && keys[i] != HASH_TOMB) { live++; }
+    }
+    t->hcap = hcap;
+    while (t->hcap < live * 4) { t->hcap *= 2; }
+    t->keys = calloc(t->hcap, sizeof(Xid));
+    t->vals = malloc(t->hcap * sizeof(int));
+    t->hcnt = 0;
+    for (int i = 0; i < hcap; i++) {
+        if (keys[i] != HASH_EMPTY && keys[i] != HASH_TOMB) {
+            table_index(t, keys[i], vals[i]);
+        }
+    }
+    free(keys);
+    free(vals);
+}
+
+void table_index(Table *t, Xid w, int slot) {
+    if ((t->hcnt + 1) * 2 > t->hcap) {
+        table_rehash(t);
+    }
+    unsigned int i = hash_window(w, t->hcap);
+    while (t->keys[i] != HASH_EMPTY && t->keys[i] != HASH_TOMB && t->keys[i] != w) {
+        i = (i + 1) & (t->hcap - 1);
+    }
+    if (t->keys[i] == HASH_EMPTY) {
+        t->hcnt++;
+    }
+    t->keys[i] = w;
+    t->vals[i] = slot;
+}
+
+void table_unindex(Table *t, Xid w) {
+    if (w == HASH_EMPTY || w == HASH_TOMB) {
+        return;
+    }
+    for (unsigned int i = hash_window(w, t->hcap);; i = (i + 1) & (t->hcap - 1)) {
+        if (t->keys[i] == w) {
+            t->keys[i] = HASH_TOMB;
+            return;
+        } else if (t->keys[i] == HASH_EMPTY) {
+            return;
+        }
+    }
+}
+
+// hands out a cleared slot, growing the store if every slot is taken
+// any Viewable pointers taken before this call may be invalidated
+int table_alloc(Table *t) {
+    int slot;
+    if (t->nfrees > 0) {
+        slot = t->frees[--t->nfrees];
+    } else {
+        if (t->used == t->cap) {
+            t->cap *= 2;
+            t->vwbls = realloc(t->vwbls, t->cap * sizeof(Viewable));
+            t->frees = realloc(t->frees, t->cap * sizeof(int));
+        }
+        slot = t->used++;
+    }
+
+    Viewable *vwbl = &t->vwbls[slot];
+    memset(vwbl, 0, sizeof(*vwbl));
+    vwbl->node = -1;
+    return slot;
+}
+
+// takes one particular slot, for rebuilding the table from a snapshot.
+// slots skipped on the way there go on the free list
+Viewable *table_claim(Table *t, int slot) {
+    while (t->used <= slot) {
+        if (t->used == t->cap) {
+            t->cap *= 2;
+            t->vwbls = realloc(t->vwbls, t->cap * sizeof(Viewable));
+            t->frees = realloc(t->frees, t->cap * sizeof(int));
+        }
+        memset(&t->vwbls[t->used], 0, sizeof(Viewable));
+        t->vwbls[t->used].node = -1;
+        t->frees[t->nfrees++] = t->used++;
+    }
+    // snapshots list slots in order, so this is nearly always the last free one
+    for (int f = t->nfrees - 1; f >= 0; f--) {
+        if (t->frees[f] == slot) {
+            t->frees[f] = t->frees[--t->nfrees];
+            break;
+        }
+    }
+    return &t->vwbls[slot];
+}
+
+// forgets both ids of a slot and puts it back on the free list
+void table_release(Table *t, int slot) {
+    Viewable *vwbl = &t->vwbls[slot];
+    table_unindex(t, vwbl->wndw);
+    table_unindex(t, vwbl->fram);
+    free(vwbl->ttl);
+    memset(vwbl, 0, sizeof(*vwbl));
+    vwbl->node = -1;
+    t->frees[t->nfrees++] = slot;
+}
+
+// queues a title redraw for the next time the event queue runs dry
+void table_mark_title(Table *t, int slot) {
+    if (!t->vwbls[slot].tdrw) {
+        t->vwbls[slot].tdrw = true;
+        if (t->ntodo == t->tcap) {
+            t->tcap *= 2;
+            t->todo = realloc(t->todo, t->tcap * sizeof(int));
+        }
+        t->todo[t->ntodo++] = slot;
+    }
+}
+
+// moves/resizes a window and records the new geometry straight away,
+// so nothing has to ask the server where the window ended up
+void move_resize(Backend *be, Xid w, Geom *geo, unsigned long *ser,
+        int x, int y, int width, int height) {
+    Geom g = { x, y, width, height };
+    *geo = g;
+    *ser = be->configure(be->ctx, w, g);
+}
+
+// frame and client geometry for a tile: 2px border on each side, title at the bottom
+void tile_geoms(Geom area, int titleh, Geom *fg, Geom *wg) {
+    fg->x = area.x;
+    fg->y = area.y;
+    fg->w = area.w > 5 ? area.w - 4 : 1;
+    fg->h = area.h > 5 ? area.h - 4 : 1;
+    wg->x = 0;
+    wg->y = 0;
+    wg->w = fg->w;
+    wg->h = fg->h > titleh ? fg->h - titleh : 1;
+}
+
+// shrinks a client size to what its size hints allow: a whole number of increments
+// on top of the base size, and never below the minimum
+void apply_hints(Viewable *vwbl, int *w, int *h) {
+    if (vwbl->incw > 1 && *w > vwbl->basew) {
+        *w -= (*w - vwbl->basew) % vwbl->incw;
+    }
+    if (vwbl->inch > 1 && *h > vwbl->baseh) {
+        *h -= (*h - vwbl->baseh) % vwbl->inch;
+    }
+    if (*w < vwbl->minw) { *w = vwbl->minw; }
+    if (*h < vwbl->minh) { *h = vwbl->minh; }
+    if (*w < 1) { *w = 1; }
+    if (*h < 1) { *h = 1; }
+}
+
+void tree_init(Tree *tree) {
+    memset(tree, 0, sizeof(*tree));
+    tree->cap = INIT_WINS * 2;
+    tree->nodes = malloc(tree->cap * sizeof(Node));
+    tree->frees = malloc(tree->cap * sizeof(int));
+    tree->root = -1;
+}
+
+int tree_alloc(Tree *tree) {
+    int n;
+    if (tree->nfrees > 0) {
+        n = tree->frees[--tree->nfrees];
+    } else {
+        if (tree->used == tree->cap) {
+            tree->cap *= 2;
+            tree->nodes = realloc(tree->nodes, tree->cap * sizeof(Node));
+            tree->frees = realloc(tree->frees, tree->cap * sizeof(int));
+        }
+        n = tree->used++;
+    }
+    memset(&tree->nodes[n], 0, sizeof(Node));
+    tree->nodes[n].prnt = -1;
+    tree->nodes[n].kids[0] = -1;
+    tree->nodes[n].kids[1] = -1;
+    tree->nodes[n].slot = -1;
+    return n;
+}
+
+// same as table_claim, for nodes
+Node *tree_claim(Tree *tree, int n) {
+    while (tree->used <= n) {
+        if (tree->used == tree->cap) {
+            tree->cap *= 2;
+            tree->nodes = realloc(tree->nodes, tree->cap * sizeof(Node));
+            tree->frees = realloc(tree->frees, tree->cap * sizeof(int));
+        }
+        tree->frees[tree->nfrees++] = tree->used++;
+    }
+    for (int f = tree->nfrees - 1; f >= 0; f--) {
+        if (tree->frees[f] == n) {
+            tree->frees[f] = tree->frees[--tree->nfrees];
+            break;
+        }
+    }
+    return &tree->nodes[n];
+}
+
+void tree_release(Tree *tree, int n) {
+    tree->frees[tree->nfrees++] = n;
+}
+
+// puts a new leaf for slot next to node at (a leaf or a whole subtree), splitting
+// the space at had in the given direction. returns the node whose subtree needs a relayout
+int tree_insert(Tree *tree, Table *wins, int at, int slot, bool vert) {
+    int leaf = tree_alloc(tree);
+    tree->nodes[leaf].slot = slot;
+    wins->vwbls[slot].node = leaf;
+
+    if (at == -1) {
+        tree->root = leaf;
+        tree->nodes[leaf].area = tree->area;
+        return leaf;
+    }
+
+    // the split takes at's place in the tree, with at and the new leaf as its kids
+    int split = tree_alloc(tree);
+    Node *nodes = tree->nodes;
+    nodes[split].vert = vert;
+    nodes[split].area = nodes[at].area;
+    nodes[split].prnt = nodes[at].prnt;
+    if (nodes[at].prnt == -1) {
+        tree->root = split;
+    } else {
+        Node *prnt = &nodes[nodes[at].prnt];
+        prnt->kids[prnt->kids[0] == at ? 0 : 1] = split;
+    }
+    nodes[split].kids[0] = at;
+    nodes[split].kids[1] = leaf;
+    nodes[at].prnt = split;
+    nodes[leaf].prnt = split;
+    return split;
+}
+
+// takes a leaf out of the tree, its sibling inherits the parent's space
+// returns the node whose subtree needs a relayout, or -1 if the tree is now empty
+int tree_remove(Tree *tree, int leaf) {
+    Node *nodes = tree->nodes;
+    int split = nodes[leaf].prnt;
+    tree_release(tree, leaf);
+    if (split == -1) {
+        tree->root = -1;
+        return -1;
+    }
+
+    int sib = nodes[split].kids[nodes[split].kids[0] == leaf ? 1 : 0];
+    nodes[sib].prnt = nodes[split].prnt;
+    nodes[sib].area = nodes[split].area;
+    if (nodes[split].prnt == -1) {
+        tree->root = sib;
+    } else {
+        Node *prnt = &nodes[nodes[split].prnt];
+        prnt->kids[prnt->kids[0] == split ? 0 : 1] = sib;
+    }
+    tree_release(tree, split);
+    return sib;
+}
+
+// first leaf found going down from n, always taking kid pick (or the shown tab)
+int tree_descend(Tree *tree, int n, int pick) {
+    while (tree->nodes[n].slot == -1) {
+        Node *node = &tree->nodes[n];
+        n = node->kids[node->tabd ? node->show : pick];
+    }
+    return n;
+}
+
+// finds the leaf next to from in direction dir, or -1 if from is already at that edge
+int tree_neighbour(Tree *tree, int from, int dir) {
+    Node *nodes = tree->nodes;
+    bool vert = dir == DIR_UP || dir == DIR_DOWN;
+    int side = (dir == DIR_LEFT || dir == DIR_UP) ? 1 : 0; // which kid we have to come from
+
+    // climb until there is a split of the right orientation with room on that side
+    int n = from;
+    while (nodes[n].prnt != -1) {
+        Node *prnt = &nodes[nodes[n].prnt];
+        if (!prnt->tabd && prnt->vert == vert && prnt->kids[side] == n) {
+            n = prnt->kids[!side];
+            break;
+        }
+        n = nodes[n].prnt;
+    }
+    if (nodes[n].prnt == -1) {
+        return -1;
+    }
+
+    // then go down, staying on the near edge and lined up with the middle of from
+    Geom fa = nodes[from].area;
+    int mid = vert ? fa.x + fa.w / 2 : fa.y + fa.h / 2;
+    while (nodes[n].slot == -1) {
+        if (nodes[n].tabd) {
+            n = nodes[n].kids[nodes[n].show];
+        } else if (nodes[n].vert == vert) {
+            n = nodes[n].kids[side];
+        } else {
+            Geom ka = nodes[nodes[n].kids[0]].area;
+            int end = vert ? ka.x + ka.w : ka.y + ka.h;
+            n = nodes[n].kids[mid < end ? 0 : 1];
+        }
+    }
+    return n;
+}
+
+// hands area to node n and everything below it, configuring only the frames and
+// clients whose geometry actually changed. the caller flushes once at the end
+void tree_layout(Backend *be, Tree *tree, Table *wins, int n, Geom area, int titleh) {
+    Node *node = &tree->nodes[n];
+    node->area = area;
+
+    if (node->slot == -1) {
+        Geom a = area;
+        Geom b = area;
+        if (node->tabd) {
+            // tabs stack, both get everything
+        } else if (node->vert) {
+            a.h = area.h / 2;
+            b.y = area.y + a.h;
+            b.h = area.h - a.h;
+        } else {
+            a.w = area.w / 2;
+            b.x = area.x + a.w;
+            b.w = area.w - a.w;
+        }
+        tree_layout(be, tree, wins, node->kids[0], a, titleh);
+        tree_layout(be, tree, wins, node->kids[1], b, titleh);
+        return;
+    }
+
+    Viewable *vwbl = &wins->vwbls[node->slot];
+    if (vwbl->fram == 0) {
+        return; // not framed yet, the frame gets created with this area
+    }
+    Geom fg, wg;
+    tile_geoms(area, titleh, &fg, &wg);
+    apply_hints(vwbl, &wg.w, &wg.h);
+    if (memcmp(&fg, &vwbl->fgeo, sizeof(Geom)) != 0) {
+        move_resize(be, vwbl->fram, &vwbl->fgeo, &vwbl->fser, fg.x, fg.y, fg.w, fg.h);
+    }
+    if (memcmp(&wg, &vwbl->wgeo, sizeof(Geom)) != 0) {
+        move_resize(be, vwbl->wndw, &vwbl->wgeo, &vwbl->wser, wg.x, wg.y, wg.w, wg.h);
+    }
+}
+
+// the nearest tabbed split above n, or -1
+int tree_tabs(Tree *tree, int n) {
+    for (n = tree->nodes[n].prnt; n != -1 && !tree->nodes[n].tabd; n = tree->nodes[n].prnt) {
+    }
+    return n;
+}
+
+// whether n sits in shown tabs all the way up
+bool tree_visible(Tree *tree, int n) {
+    for (int p = tree->nodes[n].prnt; p != -1; n = p, p = tree->nodes[p].prnt) {
+        if (tree->nodes[p].tabd && tree->nodes[p].kids[tree->nodes[p].show] != n) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// maps (vis) or unmaps the leaves below n, following which tab is shown. only the
+// windows whose state actually changes get a request, so flipping between two
+// single-window tabs touches exactly two windows. the caller flushes
+void tree_show(Backend *be, Tree *tree, Table *wins, int n, bool vis) {
+    Node *node = &tree->nodes[n];
+    if (node->slot == -1) {
+        for (int k = 0; k < 2; k++) {
+            tree_show(be, tree, wins, node->kids[k], vis && (!node->tabd || node->show == k));
+        }
+        return;
+    }
+    Viewable *vwbl = &wins->vwbls[node->slot];
+    if (vwbl->hidn == !vis) {
+        return;
+    }
+    vwbl->hidn = !vis;
+    if (!tree->live || vwbl->fram == 0) {
+        return; // the workspace switch (or framing) maps it when the time comes
+    }
+    if (vis) {
+        be->map(be->ctx, vwbl->wndw);
+        be->map(be->ctx, vwbl->fram);
+    } else {
+        be->unmap(be->ctx, vwbl->fram);
+        be->unmap(be->ctx, vwbl->wndw);
+    }
+}
+
+// queues a title redraw for every mapped leaf below n
+void tree_mark_titles(Tree *tree, Table *wins, int n) {
+    Node *node = &tree->nodes[n];
+    if (node->slot == -1) {
+        tree_mark_titles(tree, wins, node->kids[0]);
+        tree_mark_titles(tree, wins, node->kids[1]);
+    } else if (!wins->vwbls[node->slot].hidn) {
+        table_mark_title(wins, node->slot);
+    }
+}
+
+// the text for a title bar: just the title, or under a tabbed split the title
+// of every tab with the shown one in brackets
+const char *tab_label(Tree *tree, Table *wins, int slot, char *buf, int size) {
+    Viewable *vwbls = wins->vwbls;
+    int tabs = tree_tabs(tree, vwbls[slot].node);
+    if (tabs == -1) {
+        return vwbls[slot].ttl;
+    }
+    Node *node = &tree->nodes[tabs];
+    int len = 0;
+    for (int k = 0; k < 2 && len < size; k++) {
+        int leaf = k == node->show ? slot : tree->nodes[tree_descend(tree, node->kids[k], 0)].slot;
+        len += snprintf(buf + len, size - len, k == node->show ? "%s[%s]" : "%s %s ",
+                k > 0 ? " | " : "", vwbls[leaf].ttl);
+    }
+    return buf;
+}
+
+// every workspace empty, with the first one visible
+void spaces_init(Workspace *spaces) {
+    for (int n = 0; n < NSPACES; n++) {
+        for (int m = 0; m < MAX_OUTPUTS; m++) {
+            tree_init(&spaces[n].trees[m]);
+            spaces[n].trees[m].live = n == 0;
+        }
+        spaces[n].outp = 0;
+        spaces[n].subw = -1;
+    }
+}
+
+// the tree a Viewable is tiled in
+Tree *tree_of(Workspace *spaces, Viewable *vwbl) {
+    return &spaces[vwbl->wksp].trees[vwbl->outp];
+}
+
+// takes a Viewable out of its tree and lays the sibling subtree out again.
+// returns the slot that should inherit the focus, the leaf of the sibling subtree
+// closest to the old window, or -1 if the tree is now empty
+int tree_detach(Backend *be, Tree *tree, Table *wins, int slot, int titleh) {
+    int leaf = wins->vwbls[slot].node;
+    int prnt = tree->nodes[leaf].prnt;
+    int pick = prnt != -1 && tree->nodes[prnt].kids[1] == leaf;
+    int dirty = tree_remove(tree, leaf);
+    if (dirty == -1) {
+        return -1;
+    }
+    tree_layout(be, tree, wins, dirty, tree->nodes[dirty].area, titleh);
+    // if it was the shown tab, the other one comes out now
+    tree_show(be, tree, wins, dirty, tree_visible(tree, dirty));
+    int tabs = tree_tabs(tree, dirty);
+    tree_mark_titles(tree, wins, tabs == -1 ? dirty : tabs);
+    return tree->nodes[tree_descend(tree, dirty, pick)].slot;
+}
+
+// hands every tree of a workspace its output's area again, but only where that changed
+void layout_outputs(Backend *be, Workspace *wksp, Table *wins, Outputs *outs, int titleh) {
+    for (int m = 0; m < outs->n; m++) {
+        Tree *t = &wksp->trees[m];
+        if (memcmp(&t->area, &outs->area[m], sizeof(Geom)) != 0) {
+            t->area = outs->area[m];
+            if (t->root != -1) {
+                tree_layout(be, t, wins, t->root, t->area, titleh);
+            }
+        }
+    }
+}
+
+// starts tiling a new client next to the focused one (or on its own if nothing is):
+// a slot, a leaf, and a layout of whatever had to make room. the caller frames it
+// wherever the leaf's area says
+int wm_manage(Backend *be, Table *wins, Workspace *spaces, int cur, int subw,
+        Xid wndw, bool vert, int titleh) {
+    int i = table_alloc(wins);
+    Viewable *vwbls = wins->vwbls;
+    Tree *tree = &spaces[cur].trees[spaces[cur].outp];
+    vwbls[i].wndw = wndw;
+    vwbls[i].wksp = cur;
+    vwbls[i].outp = spaces[cur].outp;
+    int at = subw != -1 ? vwbls[subw].node : tree->root;
+    int dirty = tree_insert(tree, wins, at, i, vert);
+    tree_layout(be, tree, wins, dirty, tree->nodes[dirty].area, titleh);
+    table_index(wins, wndw, i);
+    return i;
+}
+
+// stops tiling a client, its sibling gets the space and (if it was focused) the focus.
+// a window on a hidden workspace only changes what that one will focus
+int wm_unmanage(Backend *be, Table *wins, Workspace *spaces, int cur, int subw,
+        int slot, int titleh) {
+    Viewable *vwbls = wins->vwbls;
+    int wk = vwbls[slot].wksp;
+    int next = tree_detach(be, tree_of(spaces, &vwbls[slot]), wins, slot, titleh);
+    if (wk != cur) {
+        if (spaces[wk].subw == slot) { spaces[wk].subw = next; }
+    } else if (subw == slot) {
+        subw = next;
+        be->focus(be->ctx, subw != -1 ? vwbls[subw].wndw : 0);
+    }
+    table_release(wins, slot);
+    return subw;
+}
+
+// focuses the neighbour in direction dir, if there is one
+int wm_focus(Backend *be, Tree *tree, Table *wins, int subw, int dir) {
+    int next = tree_neighbour(tree, wins->vwbls[subw].node, dir);
+    if (next == -1) {
+        return subw;
+    }
+    subw = tree->nodes[next].slot;
+    be->focus(be->ctx, wins->vwbls[subw].wndw);
+    return subw;
+}
+
+// swaps the visible set of windows for another workspace's. hidden clients are really
+// unmapped, not just covered up, so they stop drawing. nothing here waits on anything,
+// so the caller can send it all as one batch
+int wm_view(Backend *be, Table *wins, Workspace *spaces, Outputs *outs, int *cur, int subw,
+        int to, int titleh) {
+    Viewable *vwbls = wins->vwbls;
+    spaces[*cur].subw = subw;
+    for (int n = 0; n < wins->used; n++) {
+        if (vwbls[n].wndw != 0 && vwbls[n].wksp == *cur && !vwbls[n].hidn) {
+            be->unmap(be->ctx, vwbls[n].fram);
+            be->unmap(be->ctx, vwbls[n].wndw);
+        }
+    }
+    for (int m = 0; m < MAX_OUTPUTS; m++) {
+        spaces[*cur].trees[m].live = false;
+        spaces[to].trees[m].live = true;
+    }
+    *cur = to;
+    subw = spaces[to].subw;
+    layout_outputs(be, &spaces[to], wins, outs, titleh);
+    for (int n = 0; n < wins->used; n++) {
+        if (vwbls[n].wndw != 0 && vwbls[n].wksp == to && !vwbls[n].hidn) {
+            be->map(be->ctx, vwbls[n].wndw);
+            be->map(be->ctx, vwbls[n].fram);
+        }
+    }
+    be->focus(be->ctx, subw != -1 ? vwbls[subw].wndw : 0);
+    return subw;
+}
+
+// moves the focused window over to another workspace, it gets a tile there
+// straight away and is hidden until that one is shown
+int wm_send(Backend *be, Table *wins, Workspace *spaces, int cur, int subw, int to,
+        bool vert, int titleh) {
+    Viewable *vwbls = wins->vwbls;
+    int slot = subw;
+    Tree *tree = &spaces[cur].trees[spaces[cur].outp];
+    subw = tree_detach(be, tree, wins, slot, titleh);
+    Tree *dest = &spaces[to].trees[spaces[to].outp];
+    int at = spaces[to].subw != -1 ? vwbls[spaces[to].subw].node : dest->root;
+    int dirty = tree_insert(dest, wins, at, slot, vert);
+    tree_layout(be, dest, wins, dirty, dest->nodes[dirty].area, titleh);
+    vwbls[slot].wksp = to;
+    vwbls[slot].outp = spaces[to].outp;
+    if (spaces[to].subw == -1) { spaces[to].subw = slot; }
+    be->unmap(be->ctx, vwbls[slot].fram);
+    be->unmap(be->ctx, vwbls[slot].wndw);
+    be->focus(be->ctx, subw != -1 ? vwbls[subw].wndw : 0);
+    return subw;
+}
+
+// turns the split the focused window is in into tabs (or back), the focused
+// side stays up and the other side goes away until it's switched to
+void wm_tabbed(Backend *be, Tree *tree, Table *wins, int subw, int titleh) {
+    int leaf = wins->vwbls[subw].node;
+    int prnt = tree->nodes[leaf].prnt;
+    if (prnt == -1) {
+        return;
+    }
+    Node *node = &tree->nodes[prnt];
+    node->tabd = !node->tabd;
+    node->show = node->kids[1] == leaf;
+    tree_layout(be, tree, wins, prnt, node->area, titleh);
+    tree_show(be, tree, wins, prnt, true);
+    tree_mark_titles(tree, wins, prnt);
+}
+
+// flips the nearest tabbed split over to its other tab and focuses that
+int wm_tab(Backend *be, Tree *tree, Table *wins, int subw) {
+    int tabs = tree_tabs(tree, wins->vwbls[subw].node);
+    if (tabs == -1) {
+        return subw;
+    }
+    Node *node = &tree->nodes[tabs];
+    node->show = !node->show;
+    tree_show(be, tree, wins, node->kids[!node->show], false);
+    tree_show(be, tree, wins, node->kids[node->show], true);
+    subw = tree->nodes[tree_descend(tree, node->kids[node->show], 0)].slot;
+    be->focus(be->ctx, wins->vwbls[subw].wndw);
+    tree_mark_titles(tree, wins, tabs);
+    return subw;
+}
+
+// moves the focus step outputs over, new windows go there too
+int wm_output(Backend *be, Table *wins, Workspace *spaces, Outputs *outs, int cur, int step) {
+    Workspace *wksp = &spaces[cur];
+    wksp->outp = ((wksp->outp + step) % outs->n + outs->n) % outs->n;
+    Tree *tree = &wksp->trees[wksp->outp];
+    int subw = tree->root != -1 ? tree->nodes[tree_descend(tree, tree->root, 0)].slot : -1;
+    be->focus(be->ctx, subw != -1 ? wins->vwbls[subw].wndw : 0);
+    return subw;
+}
+
+// focuses a window picked with the mouse, its output becomes the focused one
+int wm_pick(Backend *be, Table *wins, Workspace *spaces, int cur, int slot) {
+    spaces[cur].outp = wins->vwbls[slot].outp;
+    be->focus(be->ctx, wins->vwbls[slot].wndw);
+    return slot;
+}
+
+// writes everything needed to carry on after exec: the Viewables with their cached
+// geometry, hints and titles, every tree and the focus. it's plain text with one record
+// per line, so a newer build can still read what an older one wrote
+void save_state(FILE *f, Table *wins, Workspace *spaces, int cur, int subw) {
+    fprintf(f, "armw-state 1\ncur %d\n", cur);
+    for (int n = 0; n < NSPACES; n++) {
+        fprintf(f, "space %d %d %d\n", n, spaces[n].outp, n == cur ? subw : spaces[n].subw);
+        for (int m = 0; m < MAX_OUTPUTS; m++) {
+            Tree *t = &spaces[n].trees[m];
+            if (t->root == -1) {
+                continue;
+            }
+            Geom a = t->area;
+            fprintf(f, "tree %d %d %d %d %d %d %d\n", n, m, t->root, a.x, a.y, a.w, a.h);
+            for (int k = 0; k < t->used; k++) {
+                Node *node = &t->nodes[k];
+                bool freed = false;
+                for (int r = 0; r < t->nfrees && !freed; r++) {
+                    freed = t->frees[r] == k;
+                }
+                if (!freed) {
+                    fprintf(f, "node %d %d %d %d %d %d %d %d %d %d %d %d\n", k, node->prnt,
+                            node->kids[0], node->kids[1], node->slot, node->vert, node->tabd,
+                            node->show, node->area.x, node->area.y, node->area.w, node->area.h);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < wins->used; i++) {
+        Viewable *v = &wins->vwbls[i];
+        if (v->wndw == 0) {
+            continue;
+        }
+        fprintf(f, "win %d %lu %lu %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d ",
+                i, v->wndw, v->fram, v->node, v->wksp, v->outp, v->hidn,
+                v->fgeo.x, v->fgeo.y, v->fgeo.w, v->fgeo.h,
+                v->wgeo.x, v->wgeo.y, v->wgeo.w, v->wgeo.h,
+                v->basew, v->baseh, v->incw, v->inch, v->minw, v->minh);
+        for (char *c = v->ttl; c != NULL && *c != '\0'; c++) {
+            fputc(*c == '\n' ? ' ' : *c, f);
+        }
+        fputc('\n', f);
+    }
+    fputs("end\n", f);
+}
+
+// rebuilds the table and the trees from a snapshot, without talking to the server.
+// returns false (leaving a mess for the caller to ignore) if it doesn't look right
+bool load_state(FILE *f, Table *wins, Workspace *spaces, int *cur) {
+    // titles can be as long as a client likes, so lines have no fixed length
+    char *line = NULL;
+    size_t cap = 0;
+    bool ok = false;
+    int n, m, k;
+    Tree *t = NULL;
+    if (getline(&line, &cap, f) == -1 || strcmp(line, "armw-state 1\n") != 0) {
+        free(line);
+        return false;
+    }
+    while (getline(&line, &cap, f) != -1) {
+        Node nd;
+        Viewable v;
+        int vert, tabd, hidn, off;
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "cur %d", cur) == 1) {
+            if (*cur < 0 || *cur >= NSPACES) { break; }
+        } else if (sscanf(line, "space %d %d %d", &n, &m, &k) == 3) {
+            if (n < 0 || n >= NSPACES || m < 0 || m >= MAX_OUTPUTS) { break; }
+            spaces[n].outp = m;
+            spaces[n].subw = k;
+        } else if (sscanf(line, "tree %d %d %d %d %d %d %d", &n, &m, &k,
+                    &nd.area.x, &nd.area.y, &nd.area.w, &nd.area.h) == 7) {
+            if (n < 0 || n >= NSPACES || m < 0 || m >= MAX_OUTPUTS) { break; }
+            t = &spaces[n].trees[m];
+            t->root = k;
+            t->area = nd.area;
+        } else if (sscanf(line, "node %d %d %d %d %d %d %d %d %d %d %d %d", &k, &nd.prnt,
+                    &nd.kids[0], &nd.kids[1], &nd.slot, &vert, &tabd, &nd.show,
+                    &nd.area.x, &nd.area.y, &nd.area.w, &nd.area.h) == 12) {
+            if (t == NULL || k < 0) { break; }
+            nd.vert = vert;
+            nd.tabd = tabd;
+            *tree_claim(t, k) = nd;
+        } else if (sscanf(line, "win %d %lu %lu %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %n",
+                    &k, &v.wndw, &v.fram, &v.node, &v.wksp, &v.outp, &hidn,
+                    &v.fgeo.x, &v.fgeo.y, &v.fgeo.w, &v.fgeo.h,
+                    &v.wgeo.x, &v.wgeo.y, &v.wgeo.w, &v.wgeo.h,
+                    &v.basew, &v.baseh, &v.incw, &v.inch, &v.minw, &v.minh, &off) == 21) {
+            if (k < 0 || v.wksp < 0 || v.wksp >= NSPACES || v.outp < 0 || v.outp >= MAX_OUTPUTS) {
+                break;
+            }
+            Viewable *vwbl = table_claim(wins, k);
+            memset(vwbl, 0, sizeof(*vwbl));
+            vwbl->wndw = v.wndw;
+            vwbl->fram = v.fram;
+            vwbl->node = v.node;
+            vwbl->wksp = v.wksp;
+            vwbl->outp = v.outp;
+            vwbl->hidn = hidn;
+            vwbl->fgeo = v.fgeo;
+            vwbl->wgeo = v.wgeo;
+            vwbl->basew = v.basew;
+            vwbl->baseh = v.baseh;
+            vwbl->incw = v.incw;
+            vwbl->inch = v.inch;
+            vwbl->minw = v.minw;
+            vwbl->minh = v.minh;
+            vwbl->ttl = strdup(line + off);
+        } else if (strcmp(line, "end") == 0) {
+            ok = true;
+            break;
+        }
+    }
+    free(line);
+    return ok;
+}
+
@@ -0,0 +1,209 @@
+#ifndef ARMW_LAYOUT_H
+#define ARMW_LAYOUT_H
+
+// the part of Armw that doesn't need a server: the Viewable table, the split trees,
+// workspaces and outputs, and what the key bindings do to them. anything that has to
+// reach the screen goes through a Backend, which is Xlib in armw.c and a mock in replay.c
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define INIT_WINS 32
+#define NSPACES 9
+#define MAX_OUTPUTS 8
+
+// a window (or pixmap) id, the same thing Xlib calls an XID
+typedef unsigned long Xid;
+
+// plain rectangle, x/y are the outer corner and w/h the inside size
+// (the same thing XGetWindowAttributes would report)
+typedef struct Geom Geom;
+struct Geom {
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+// Viewable struct for storing window-frame pair
+// plus possibly some other stuff later
+typedef struct Viewable Viewable;
+struct Viewable {
+    Xid wndw;
+    Xid fram;
+    int node; // leaf of the tiling tree this Viewable sits in
+    int wksp; // and the workspace that tree belongs to
+    int outp; // and the output
+    bool hidn; // unmapped because it sits in a tab that isn't shown
+    // property reads underway on the fetch worker (a bit per kind), the ones
+    // that have to be done again once the answer is in, and the ones that
+    // didn't fit in the ring and wait for room
+    unsigned char fpnd;
+    unsigned char fagn;
+    unsigned char fdly;
+    unsigned char prot; // what WM_PROTOCOLS says, as P_* bits (see armw.c)
+    // cached title (utf-8) and its width, only refetched when WM_NAME/_NET_WM_NAME change
+    char *ttl;
+    int twid;
+    bool tdrw; // title needs to be rendered again
+    // the title strip rendered once, exposes just copy it onto the frame
+    Xid tpix;
+    struct _XftDraw *txft; // xft's handle on tpix, lives and dies with it
+    int tpw;
+    int tph;
+    struct _XGC *gc;   // shared with every other frame using the same colors, see get_pen
+    struct _XGC *fill; // same, but draws in the background color
+    // frame geometry and client geometry (relative to the frame), authoritative on our side:
+    // updated as soon as we configure something and confirmed by ConfigureNotify
+    Geom fgeo;
+    Geom wgeo;
+    // serials of the last configure we sent, older ConfigureNotifys are stale
+    unsigned long fser;
+    unsigned long wser;
+    // size hints from WM_NORMAL_HINTS, refetched only when that property changes
+    int basew;
+    int baseh;
+    int incw;
+    int inch;
+    int minw;
+    int minh;
+};
+
+// growable store of Viewables. slots are recycled through a free list and never move
+// index-wise (so neighbour links stay valid), and every client and frame id is hashed
+// to its slot so that event routing never has to scan
+typedef struct Table Table;
+struct Table {
+    Viewable *vwbls;
+    int cap;
+    int used;   // high water mark, slots past this were never handed out
+    int *frees; // stack of released slots
+    int nfrees;
+    // open addressing, linear probing, capacity is always a power of two
+    Xid *keys;
+    int *vals;
+    int hcap;
+    int hcnt;   // live keys plus tombstones
+    // slots whose title needs to be redrawn once the event queue is drained
+    int *todo;
+    int ntodo;
+    int tcap;
+};
+
+// node of the tiling tree. leaves hold a Viewable, splits share their area between
+// two kids, either side by side or (vert) stacked on top of each other.
+// tabbed splits give both kids all of it instead, and only the shown kid is mapped
+typedef struct Node Node;
+struct Node {
+    int prnt;    // -1 for the root
+    int kids[2]; // -1 for leaves
+    int slot;    // Viewable slot for leaves, -1 for splits
+    bool vert;
+    bool tabd;
+    int show;    // kid that is mapped when tabd
+    Geom area;   // outer area (borders included) from the last layout
+};
+
+// binary split tree behind the tiling, nodes are recycled just like table slots
+typedef struct Tree Tree;
+struct Tree {
+    Node *nodes;
+    int cap;
+    int used;
+    int *frees;
+    int nfrees;
+    int root;    // -1 while nothing is tiled
+    Geom area;   // the whole screen
+    bool live;   // belongs to the visible workspace, so its windows may be mapped
+};
+
+// a virtual desktop, only the clients of the visible one are mapped.
+// it spans every output, with a tree for each
+typedef struct Workspace Workspace;
+struct Workspace {
+    Tree trees[MAX_OUTPUTS];
+    int outp;    // output with the focus
+    int subw;    // focused slot (always in trees[outp]), -1 when empty
+};
+
+// the monitors we tile on. fetched at startup and then only when the screen changes,
+// so nothing else ever has to ask the server how big things are
+typedef struct Outputs Outputs;
+struct Outputs {
+    Geom area[MAX_OUTPUTS];
+    int n;
+    int evb;     // randr event base, -1 without the extension
+    int hz;      // fastest refresh rate among them
+};
+
+// directions for focus navigation through the tree
+enum { DIR_LEFT, DIR_DOWN, DIR_UP, DIR_RIGHT };
+
+// where the core's requests end up. configure returns the serial of the request,
+// so the ConfigureNotifys that predate it can be told apart. focusing 0 means nobody (root)
+typedef struct Backend Backend;
+struct Backend {
+    void *ctx;
+    unsigned long (*configure)(void *ctx, Xid w, Geom g);
+    void (*map)(void *ctx, Xid w);
+    void (*unmap)(void *ctx, Xid w);
+    void (*focus)(void *ctx, Xid w);
+};
+
+// table of Viewables
+void table_init(Table *t);
+int table_find(Table *t, Xid w);
+void table_index(Table *t, Xid w, int slot);
+void table_unindex(Table *t, Xid w);
+int table_alloc(Table *t);
+Viewable *table_claim(Table *t, int slot);
+void table_release(Table *t, int slot);
+void table_mark_title(Table *t, int slot);
+
+// geometry
+void move_resize(Backend *be, Xid w, Geom *geo, unsigned long *ser,
+        int x, int y, int width, int height);
+void tile_geoms(Geom area, int titleh, Geom *fg, Geom *wg);
+void apply_hints(Viewable *vwbl, int *w, int *h);
+
+// split trees
+void tree_init(Tree *tree);
+Node *tree_claim(Tree *tree, int n);
+int tree_insert(Tree *tree, Table *wins, int at, int slot, bool vert);
+int tree_remove(Tree *tree, int leaf);
+int tree_descend(Tree *tree, int n, int pick);
+int tree_neighbour(Tree *tree, int from, int dir);
+void tree_layout(Backend *be, Tree *tree, Table *wins, int n, Geom area, int titleh);
+int tree_tabs(Tree *tree, int n);
+bool tree_visible(Tree *tree, int n);
+void tree_show(Backend *be, Tree *tree, Table *wins, int n, bool vis);
+void tree_mark_titles(Tree *tree, Table *wins, int n);
+const char *tab_label(Tree *tree, Table *wins, int slot, char *buf, int size);
+int tree_detach(Backend *be, Tree *tree, Table *wins, int slot, int titleh);
+
+// workspaces and outputs
+void spaces_init(Workspace *spaces);
+Tree *tree_of(Workspace *spaces, Viewable *vwbl);
+void layout_outputs(Backend *be, Workspace *wksp, Table *wins, Outputs *outs, int titleh);
+
+// what the bindings (and map/destroy) do. the ones returning an int return
+// the slot with the focus on the visible workspace afterwards
+int wm_manage(Backend *be, Table *wins, Workspace *spaces, int cur, int subw,
+        Xid wndw, bool vert, int titleh);
+int wm_unmanage(Backend *be, Table *wins, Workspace *spaces, int cur, int subw,
+        int slot, int titleh);
+int wm_focus(Backend *be, Tree *tree, Table *wins, int subw, int dir);
+int wm_view(Backend *be, Table *wins, Workspace *spaces, Outputs *outs, int *cur, int subw,
+        int to, int titleh);
+int wm_send(Backend *be, Table *wins, Workspace *spaces, int cur, int subw, int to,
+        bool vert, int titleh);
+void wm_tabbed(Backend *be, Tree *tree, Table *wins, int subw, int titleh);
+int wm_tab(Backend *be, Tree *tree, Table *wins, int subw);
+int wm_output(Backend *be, Table *wins, Workspace *spaces, Outputs *outs, int cur, int step);
+int wm_pick(Backend *be, Table *wins, Workspace *spaces, int cur, int slot);
+
+// snapshots for in-place restarts
+void save_state(FILE *f, Table *wins, Workspace *spaces, int cur, int subw);
+bool load_state(FILE *f, Table *wins, Workspace *spaces, int *cur);
+
+#endif
@@ -0,0 +1,402 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "layout.h"
+
+// replays what Armw recorded with ARMW_RECORD set (or a generated workload) against the
+// layout code alone, see the replay target in the Makefile. the backend only counts what
+// it is asked to do, and the trees are checked after every step, so a layout change can
+// be timed and tested without a server
+
+#define FRAME_BIT 0x40000000ul // our made up frame ids, real ids never get this high
+
+// what the core asked for, per kind of request
+typedef struct Mock Mock;
+struct Mock {
+    unsigned long configures;
+    unsigned long maps;
+    unsigned long unmaps;
+    unsigned long focuses;
+    Xid focused;
+};
+
+unsigned long mock_configure(void *ctx, Xid w, Geom g) {
+    Mock *m = ctx;
+    return ++m->configures;
+}
+
+void mock_map(void *ctx, Xid w) {
+    ((Mock *)ctx)->maps++;
+}
+
+void mock_unmap(void *ctx, Xid w) {
+    ((Mock *)ctx)->unmaps++;
+}
+
+void mock_focus(void *ctx, Xid w) {
+    Mock *m = ctx;
+    m->focuses++;
+    m->focused = w;
+}
+
+// the part of main's state the layout code works on
+typedef struct World World;
+struct World {
+    Backend be;
+    Table wins;
+    Workspace spaces[NSPACES];
+    Outputs outs;
+    int cur;
+    int subw;
+    bool vert;
+    int titleh;
+};
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void world_init(World *wld, Mock *mock, int nouts) {
+    memset(wld, 0, sizeof(*wld));
+    Backend be = { mock, mock_configure, mock_map, mock_unmap, mock_focus };
+    wld->be = be;
+    table_init(&wld->wins);
+    spaces_init(wld->spaces);
+    wld->outs.evb = -1;
+    wld->outs.n = nouts;
+    for (int m = 0; m < nouts; m++) {
+        Geom area = { m * 1920, 0, 1920, 1080 };
+        wld->outs.area[m] = area;
+    }
+    for (int n = 0; n < NSPACES; n++) {
+        for (int m = 0; m < nouts; m++) {
+            wld->spaces[n].trees[m].area = wld->outs.area[m];
+        }
+    }
+    wld->subw = -1;
+    wld->titleh = 14;
+}
+
+// what the MapRequest branch does after wm_manage, minus the server
+void frame(World *wld, int i) {
+    Viewable *vwbl = &wld->wins.vwbls[i];
+    Geom fg, wg;
+    tile_geoms(tree_of(wld->spaces, vwbl)->nodes[vwbl->node].area, wld->titleh, &fg, &wg);
+    vwbl->fram = vwbl->wndw | FRAME_BIT;
+    move_resize(&wld->be, vwbl->fram, &vwbl->fgeo, &vwbl->fser, fg.x, fg.y, fg.w, fg.h);
+    move_resize(&wld->be, vwbl->wndw, &vwbl->wgeo, &vwbl->wser, wg.x, wg.y, wg.w, wg.h);
+    wld->be.map(wld->be.ctx, vwbl->wndw);
+    wld->be.map(wld->be.ctx, vwbl->fram);
+    table_index(&wld->wins, vwbl->fram, i);
+    table_mark_title(&wld->wins, i);
+}
+
+// runs one line of a trace, false if it makes no sense
+bool step(World *wld, const char *line) {
+    char op[16];
+    unsigned long arg = 0;
+    int n = sscanf(line, "%15s %lu", op, &arg);
+    if (n < 1) {
+        return true; // blank
+    }
+    Table *wins = &wld->wins;
+    Workspace *wksp = &wld->spaces[wld->cur];
+    Tree *tree = &wksp->trees[wksp->outp];
+    int subw = wld->subw;
+    int to = (int)arg;
+
+    if (strcmp(op, "map") == 0 && n == 2) {
+        if (arg == 0 || table_find(wins, arg) != -1) {
+            return true;
+        }
+        int i = wm_manage(&wld->be, wins, wld->spaces, wld->cur, subw, arg, wld->vert,
+                wld->titleh);
+        frame(wld, i);
+        if (subw == -1) {
+            wld->be.focus(wld->be.ctx, arg);
+            wld->subw = i;
+        }
+    } else if (strcmp(op, "destroy") == 0 && n == 2) {
+        int i = table_find(wins, arg);
+        if (i != -1 && wins->vwbls[i].wndw == arg) {
+            wld->be.unmap(wld->be.ctx, wins->vwbls[i].fram);
+            wld->subw = wm_unmanage(&wld->be, wins, wld->spaces, wld->cur, subw, i,
+                    wld->titleh);
+        }
+    } else if (strcmp(op, "tile") == 0 && n == 2) {
+        wld->vert = arg;
+    } else if (strcmp(op, "view") == 0 && n == 2 && to < NSPACES) {
+        if (to != wld->cur) {
+            wld->subw = wm_view(&wld->be, wins, wld->spaces, &wld->outs, &wld->cur, subw, to,
+                    wld->titleh);
+        }
+    } else if (strcmp(op, "pick") == 0 && n == 2) {
+        // only a visible window can be clicked on
+        int i = table_find(wins, arg);
+        if (i != -1 && wins->vwbls[i].wndw == arg && wins->vwbls[i].wksp == wld->cur
+                && !wins->vwbls[i].hidn) {
+            wld->subw = wm_pick(&wld->be, wins, wld->spaces, wld->cur, i);
+        }
+    } else if (strcmp(op, "output") == 0 && n == 2) {
+        if (wld->outs.n > 1) {
+            wld->subw = wm_output(&wld->be, wins, wld->spaces, &wld->outs, wld->cur, (int)arg);
+        }
+    } else if (subw == -1 && (strcmp(op, "focus") == 0 || strcmp(op, "send") == 0
+                || strcmp(op, "tabbed") == 0 || strcmp(op, "tab") == 0)) {
+        // nothing focused, nothing to do, same as in armw
+    } else if (strcmp(op, "focus") == 0 && n == 2 && arg <= DIR_RIGHT) {
+        wld->subw = wm_focus(&wld->be, tree, wins, subw, (int)arg);
+    } else if (strcmp(op, "send") == 0 && n == 2 && to < NSPACES) {
+        if (to != wld->cur) {
+            wld->subw = wm_send(&wld->be, wins, wld->spaces, wld->cur, subw, to, wld->vert,
+                    wld->titleh);
+        }
+    } else if (strcmp(op, "tabbed") == 0) {
+        wm_tabbed(&wld->be, tree, wins, subw, wld->titleh);
+    } else if (strcmp(op, "tab") == 0) {
+        wld->subw = wm_tab(&wld->be, tree, wins, subw);
+    } else {
+        return false;
+    }
+
+    // armw renders the titles once its queue is drained, here they're just forgotten
+    for (int i = 0; i < wins->ntodo; i++) {
+        wins->vwbls[wins->todo[i]].tdrw = false;
+    }
+    wins->ntodo = 0;
+    return true;
+}
+
+// walks a subtree checking the links both ways, counts its leaves
+const char *check_node(World *wld, Tree *tree, int n, int wk, int m, int *leaves) {
+    Node *node = &tree->nodes[n];
+    if (node->slot != -1) {
+        if (node->kids[0] != -1 || node->kids[1] != -1) {
+            return "leaf with kids";
+        }
+        if (node->slot >= wld->wins.used) {
+            return "leaf points past the table";
+        }
+        Viewable *vwbl = &wld->wins.vwbls[node->slot];
+        if (vwbl->wndw == 0 || vwbl->node != n) {
+            return "leaf and slot disagree";
+        }
+        if (vwbl->wksp != wk || vwbl->outp != m) {
+            return "slot is in a tree that isn't its own";
+        }
+        (*leaves)++;
+        return NULL;
+    }
+    for (int k = 0; k < 2; k++) {
+        int kid = node->kids[k];
+        if (kid < 0 || kid >= tree->used || tree->nodes[kid].prnt != n) {
+            return "split and kid disagree";
+        }
+        const char *err = check_node(wld, tree, kid, wk, m, leaves);
+        if (err != NULL) {
+            return err;
+        }
+    }
+    return NULL;
+}
+
+// everything main relies on: every live slot sits in exactly the tree it says and can be
+// found by both its ids, and the focus is on a live slot of the visible workspace
+const char *check(World *wld) {
+    int leaves = 0;
+    for (int wk = 0; wk < NSPACES; wk++) {
+        for (int m = 0; m < MAX_OUTPUTS; m++) {
+            Tree *tree = &wld->spaces[wk].trees[m];
+            if (tree->root == -1) {
+                continue;
+            }
+            if (tree->nodes[tree->root].prnt != -1) {
+                return "root has a parent";
+            }
+            const char *err = check_node(wld, tree, tree->root, wk, m, &leaves);
+            if (err != NULL) {
+                return err;
+            }
+        }
+    }
+    int live = 0;
+    for (int i = 0; i < wld->wins.used; i++) {
+        Viewable *vwbl = &wld->wins.vwbls[i];
+        if (vwbl->wndw == 0) {
+            continue;
+        }
+        live++;
+        if (table_find(&wld->wins, vwbl->wndw) != i || table_find(&wld->wins, vwbl->fram) != i) {
+            return "ids don't hash to their slot";
+        }
+    }
+    if (live != leaves) {
+        return "slots that aren't in any tree";
+    }
+    int subw = wld->subw;
+    if (subw != -1 && (subw >= wld->wins.used || wld->wins.vwbls[subw].wndw == 0
+                || wld->wins.vwbls[subw].wksp != wld->cur)) {
+        return "focus is on a slot that isn't visible";
+    }
+    return NULL;
+}
+
+// a made up session: nwins windows mapped with the focus wandering around, by key or by
+// click, and the odd workspace, tab or tiling change in between, then all of them
+// destroyed in random order
+int generate(char ***out, int nwins) {
+    int cap = nwins * 3;
+    char **lines = malloc(cap * sizeof(char *));
+    int n = 0;
+    char buf[64];
+    for (int i = 1; i <= nwins; i++) {
+        snprintf(buf, sizeof(buf), "map %d", i);
+        lines[n++] = strdup(buf);
+        int r = rand() % 100;
+        if (r < 50) {
+            snprintf(buf, sizeof(buf), "focus %d", rand() % 4);
+        } else if (r < 60) {
+            snprintf(buf, sizeof(buf), "tile %d", rand() % 2);
+        } else if (r < 62) {
+            snprintf(buf, sizeof(buf), "view %d", rand() % NSPACES);
+        } else if (r < 64) {
+            snprintf(buf, sizeof(buf), "send %d", rand() % NSPACES);
+        } else if (r < 66) {
+            snprintf(buf, sizeof(buf), "tabbed");
+        } else if (r < 68) {
+            snprintf(buf, sizeof(buf), "tab");
+        } else if (r < 73) {
+            snprintf(buf, sizeof(buf), "pick %d", 1 + rand() % i);
+        } else {
+            continue;
+        }
+        lines[n++] = strdup(buf);
+    }
+    int *order = malloc(nwins * sizeof(int));
+    for (int i = 0; i < nwins; i++) {
+        order[i] = i + 1;
+    }
+    for (int i = nwins - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (int i = 0; i < nwins; i++) {
+        snprintf(buf, sizeof(buf), "destroy %d", order[i]);
+        lines[n++] = strdup(buf);
+    }
+    free(order);
+    *out = lines;
+    return n;
+}
+
+// the whole trace, one line per entry
+int load(char ***out, FILE *f) {
+    int cap = 1024;
+    char **lines = malloc(cap * sizeof(char *));
+    int n = 0;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        if (n == cap) {
+            cap *= 2;
+            lines = realloc(lines, cap * sizeof(char *));
+        }
+        buf[strcspn(buf, "\n")] = '\0';
+        lines[n++] = strdup(buf);
+    }
+    *out = lines;
+    return n;
+}
+
+void usage() {
+    fputs("usage: armw-replay [-n windows] [-s seed] [-o outputs] [-q] [trace]\n"
+            "  replays a trace recorded with ARMW_RECORD, or generates one for -n windows\n"
+            "  -q only checks the trees once, at the end\n", stderr);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int nwins = 0;
+    int nouts = 1;
+    unsigned int seed = 1;
+    bool quick = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            nwins = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            nouts = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quick = true;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if ((path == NULL) == (nwins <= 0) || nouts < 1 || nouts > MAX_OUTPUTS) {
+        usage();
+    }
+
+    char **lines;
+    int nlines;
+    if (path != NULL) {
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            perror(path);
+            return 2;
+        }
+        nlines = load(&lines, f);
+        fclose(f);
+    } else {
+        srand(seed);
+        nlines = generate(&lines, nwins);
+    }
+
+    Mock mock;
+    memset(&mock, 0, sizeof(mock));
+    World wld;
+    world_init(&wld, &mock, nouts);
+
+    // only the layout is timed, not the checks
+    double spent = 0;
+    double worst = 0;
+    int most = 0;
+    for (int i = 0; i < nlines; i++) {
+        double t0 = now_us();
+        bool ok = step(&wld, lines[i]);
+        double dt = now_us() - t0;
+        spent += dt;
+        if (dt > worst) { worst = dt; }
+        if (!ok) {
+            fprintf(stderr, "armw-replay: line %d: can't make sense of '%s'\n", i + 1, lines[i]);
+            return 1;
+        }
+        const char *err = quick && i < nlines - 1 ? NULL : check(&wld);
+        if (err != NULL) {
+            fprintf(stderr, "armw-replay: line %d ('%s'): %s\n", i + 1, lines[i], err);
+            return 1;
+        }
+        if (wld.wins.used - wld.wins.nfrees > most) {
+            most = wld.wins.used - wld.wins.nfrees;
+        }
+    }
+
+    printf("armw-replay: %d steps, up to %d windows\n", nlines, most);
+    printf("time      total=%.1fms  per step=%.2fus  worst=%.1fus\n", spent / 1000,
+            nlines > 0 ? spent / nlines : 0, worst);
+    printf("requests  configure=%lu  map=%lu  unmap=%lu  focus=%lu\n", mock.configures,
+            mock.maps, mock.unmaps, mock.focuses);
+    for (int i = 0; i < nlines; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    return 0;
+}